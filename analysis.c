@@ -0,0 +1,253 @@
+#include "analysis.h"
+#include "game.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/** Index used as null link of the lists of the cache */
+#define NO_ENTRY -1
+
+/**
+ * Evaluation of a position in the cache.
+ *
+ * Entries are linked in LRU order (most recent first) and chained in the bucket of their hash.
+ */
+typedef struct analysisEntry{
+
+	tHash hash;							/** Zobrist hash of the board and the player to move */
+	char board[BOARD_WIDTH * BOARD_HEIGHT];	/** Board, to reject positions with the same hash */
+	conecta4ns__tPlayer player;			/** Player that must move */
+	int budgetMillis;					/** Time budget of the search that produced the result */
+	int column;							/** Best column */
+	int score;							/** Score of the best column */
+	int depth;							/** Depth of the deepest finished iteration */
+	int prev;							/** More recently used entry */
+	int next;							/** Less recently used entry */
+	int chain;							/** Next entry in the same bucket */
+}tAnalysisEntry;
+
+/** Entries of the cache */
+static tAnalysisEntry entries[ANALYSIS_CACHE_SIZE];
+
+/** First entry of each bucket */
+static int buckets[ANALYSIS_CACHE_BUCKETS];
+
+/** Most recently used entry */
+static int head = NO_ENTRY;
+
+/** Least recently used entry, the next one to be replaced */
+static int tail = NO_ENTRY;
+
+/** Number of entries in use */
+static int usedEntries = 0;
+
+/** Lock of the cache */
+static pthread_mutex_t lockCache = PTHREAD_MUTEX_INITIALIZER;
+
+/** Transposition table shared by the searches */
+static tTTable table;
+
+/** TRUE if the transposition table has been allocated */
+static int tableReady = FALSE;
+
+/** Searches running now */
+static int runningSearches = 0;
+
+/** Counters of the requests */
+static tAnalysisCounters counters;
+
+
+static void unlinkEntry (int index){
+
+	if (entries[index].prev != NO_ENTRY)
+		entries[entries[index].prev].next = entries[index].next;
+	else
+		head = entries[index].next;
+
+	if (entries[index].next != NO_ENTRY)
+		entries[entries[index].next].prev = entries[index].prev;
+	else
+		tail = entries[index].prev;
+}
+
+static void pushFront (int index){
+
+	entries[index].prev = NO_ENTRY;
+	entries[index].next = head;
+
+	if (head != NO_ENTRY)
+		entries[head].prev = index;
+	head = index;
+
+	if (tail == NO_ENTRY)
+		tail = index;
+}
+
+/**
+ * Removes an entry from the chain of its bucket
+ */
+static void unchainEntry (int index){
+
+    int *link = &buckets[entries[index].hash & (ANALYSIS_CACHE_BUCKETS - 1)];
+
+	while (*link != index)
+		link = &entries[*link].chain;
+
+	*link = entries[index].chain;
+}
+
+/**
+ * Finds a position in the cache
+ *
+ * @return Index of the entry, or NO_ENTRY if the position is not cached
+ */
+static int findEntry (tHash hash, xsd__string board, conecta4ns__tPlayer player){
+
+	for (int i = buckets[hash & (ANALYSIS_CACHE_BUCKETS - 1)]; i != NO_ENTRY; i = entries[i].chain)
+		if (entries[i].hash == hash && entries[i].player == player &&
+			memcmp(entries[i].board, board, BOARD_WIDTH * BOARD_HEIGHT) == 0)
+			return i;
+
+	return NO_ENTRY;
+}
+
+static int isSolved (int score){
+	return score > SEARCH_WIN_THRESHOLD || score < -SEARCH_WIN_THRESHOLD;
+}
+
+/**
+ * Looks for a result that is good enough for the budget of a request
+ *
+ * @return TRUE if the result has been copied, or FALSE in another case
+ */
+static int lookupCache (tHash hash, xsd__string board, conecta4ns__tPlayer player, int budgetMillis,
+						conecta4ns__tAnalysis *analysis){
+
+    int index, found = FALSE;
+
+	pthread_mutex_lock(&lockCache);
+
+	index = findEntry(hash, board, player);
+
+	// Results of shorter searches are not reused, unless the position is solved
+	if (index != NO_ENTRY && (entries[index].budgetMillis >= budgetMillis || isSolved(entries[index].score))){
+		analysis->column = entries[index].column;
+		analysis->score = entries[index].score;
+		analysis->depth = entries[index].depth;
+		unlinkEntry(index);
+		pushFront(index);
+		found = TRUE;
+	}
+
+	pthread_mutex_unlock(&lockCache);
+
+	return found;
+}
+
+/**
+ * Stores the result of a search, replacing the least recently used entry if the cache is full
+ */
+static void storeCache (tHash hash, xsd__string board, conecta4ns__tPlayer player, int budgetMillis,
+						conecta4ns__tAnalysis *analysis){
+
+    int index;
+
+	pthread_mutex_lock(&lockCache);
+
+	// Another request may have analyzed the same position meanwhile
+	index = findEntry(hash, board, player);
+
+	if (index != NO_ENTRY){
+		if (entries[index].budgetMillis > budgetMillis && !isSolved(analysis->score)){
+			pthread_mutex_unlock(&lockCache);
+			return;
+		}
+		unlinkEntry(index);
+	}
+	else{
+		if (usedEntries < ANALYSIS_CACHE_SIZE)
+			index = usedEntries++;
+		else{
+			index = tail;
+			unlinkEntry(index);
+			unchainEntry(index);
+		}
+
+		entries[index].hash = hash;
+		memcpy(entries[index].board, board, BOARD_WIDTH * BOARD_HEIGHT);
+		entries[index].player = player;
+		entries[index].chain = buckets[hash & (ANALYSIS_CACHE_BUCKETS - 1)];
+		buckets[hash & (ANALYSIS_CACHE_BUCKETS - 1)] = index;
+	}
+
+	entries[index].budgetMillis = budgetMillis;
+	entries[index].column = analysis->column;
+	entries[index].score = analysis->score;
+	entries[index].depth = analysis->depth;
+	pushFront(index);
+
+	pthread_mutex_unlock(&lockCache);
+}
+
+void initAnalysis (){
+
+	for (int i = 0; i < ANALYSIS_CACHE_BUCKETS; i++)
+		buckets[i] = NO_ENTRY;
+	head = tail = NO_ENTRY;
+	usedEntries = 0;
+	memset(&counters, 0, sizeof(counters));
+
+	// Without the table the searches are slower, but still correct
+	tableReady = ttInit(&table, (size_t) TT_DEFAULT_MB * 1024 * 1024);
+	if (!tableReady)
+		fprintf(stderr, "Analysis without transposition table: not enough memory\n");
+}
+
+void analyzeBoard (xsd__string board, conecta4ns__tPlayer player, tHash hash, int budgetMillis, conecta4ns__tAnalysis *analysis){
+
+    tSearchStats stats;
+    struct timespec start, end;
+
+	__sync_fetch_and_add(&counters.requests, 1);
+
+	analysis->code = TURN_MOVE;
+	analysis->player = player;
+	analysis->cached = FALSE;
+	analysis->searchMicros = 0;
+
+	// Popular positions are answered without searching
+	if (lookupCache(hash, board, player, budgetMillis, analysis)){
+		analysis->cached = TRUE;
+		__sync_fetch_and_add(&counters.hits, 1);
+		return;
+	}
+
+	// Each search takes a core for the whole budget, so they are limited
+	if (__sync_add_and_fetch(&runningSearches, 1) > ANALYSIS_MAX_SEARCHES){
+		__sync_fetch_and_sub(&runningSearches, 1);
+		__sync_fetch_and_add(&counters.busy, 1);
+		analysis->code = ERROR_SERVER_BUSY;
+		analysis->column = -1;
+		analysis->score = 0;
+		analysis->depth = 0;
+		return;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	analysis->column = searchTimed(board, player, budgetMillis, tableReady ? &table : NULL,
+								   &stats, &analysis->score, &analysis->depth);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	__sync_fetch_and_sub(&runningSearches, 1);
+
+	analysis->searchMicros = (int) ((end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000);
+	__sync_fetch_and_add(&counters.searches, 1);
+	__sync_fetch_and_add(&counters.searchMicros, (unsigned long) analysis->searchMicros);
+
+	storeCache(hash, board, player, budgetMillis, analysis);
+}
+
+void getAnalysisCounters (tAnalysisCounters *result){
+	*result = counters;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "soapH.h"
+#include "search.h"
+
+/** Number of positions kept in the cache of evaluations */
+#define ANALYSIS_CACHE_SIZE 4096
+
+/** Number of buckets of the cache (must be a power of two) */
+#define ANALYSIS_CACHE_BUCKETS 8192
+
+/** Time budget used when the caller does not give one (in milliseconds) */
+#define ANALYSIS_DEFAULT_BUDGET_MS 200
+
+/** Maximum time budget of an analysis (in milliseconds) */
+#define ANALYSIS_MAX_BUDGET_MS 2000
+
+/** Maximum number of searches running at the same time. Requests over it are rejected */
+#define ANALYSIS_MAX_SEARCHES 4
+
+/**
+ * Counters of the analysis requests
+ */
+typedef struct analysisCounters{
+
+	unsigned long requests;				/** Analyzed positions */
+	unsigned long hits;					/** Positions answered by the cache */
+	unsigned long searches;				/** Positions answered by a new search */
+	unsigned long searchMicros;			/** Total time spent searching (in microseconds) */
+	unsigned long busy;					/** Requests rejected because too many searches were running */
+}tAnalysisCounters;
+
+/**
+ * Allocates the transposition table of the analysis and clears the cache
+ */
+void initAnalysis ();
+
+/**
+ * Evaluates a position, from the cache if it has been analyzed with enough time
+ *
+ * Fills code (TURN_MOVE or ERROR_SERVER_BUSY), column, score, depth, cached and searchMicros.
+ *
+ * @param board Board to be analyzed. It is not modified
+ * @param player Player that must move
+ * @param hash Zobrist hash of the board and the player to move, the key of the cache
+ * @param budgetMillis Time budget of the search (in milliseconds)
+ * @param analysis Structure where the result is stored
+ */
+void analyzeBoard (xsd__string board, conecta4ns__tPlayer player, tHash hash, int budgetMillis, conecta4ns__tAnalysis *analysis);
+
+/**
+ * Gets the counters of the analysis requests
+ *
+ * @param counters Structure where the counters are copied
+ */
+void getAnalysisCounters (tAnalysisCounters *counters);
+
+#endif
\ No newline at end of file
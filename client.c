@@ -89,26 +89,47 @@ int main(int argc, char **argv){
 
 	// Check arguments
 	if (argc != 2) {
-		printf("Usage: %s http://server:port\n", argv[0]);
+		printf("Usage: %s http://server:port | unix:/path/to/socket\n", argv[0]);
 		exit(0);
 	}
 
+	// Co-located servers can be reached through a Unix domain socket
+	useUnixEndpoint(&soap, &serverURL);
+
 	// Add player to the match
 	int matchID;
+	conecta4ns__tAdmission admission;
+	unsigned int attempt = 0;
+	int askName = TRUE;
+	srand(time(NULL) ^ getpid());
 	do{
-		printf("Introduce tu nombre: ");
-		fgets(playerName.msg, STRING_LENGTH - 1, stdin);
-		playerName.__size = strlen(playerName.msg);
-		playerName.msg[playerName.__size - 1] = '\0';	// Eliminate the '\n'
-		soap_call_conecta4ns__register(&soap, serverURL, "", playerName, &matchID);
-
-		if(matchID == ERROR_SERVER_FULL){
-			printf("Servidor lleno. Porfavor espere.\n");
+		if(askName){
+			printf("Introduce tu nombre: ");
+			fgets(playerName.msg, STRING_LENGTH - 1, stdin);
+			playerName.__size = strlen(playerName.msg);
+			playerName.msg[playerName.__size - 1] = '\0';	// Eliminate the '\n'
+			askName = FALSE;
+		}
+
+		// Errors in the connection are handled as a busy server
+		if(soap_call_conecta4ns__register(&soap, serverURL, "", playerName, &admission) != SOAP_OK){
+			admission.code = ERROR_SERVER_BUSY;
+			admission.retryAfter = 0;
+		}
+		matchID = admission.code;
+
+		if(matchID == ERROR_SERVER_FULL || matchID == ERROR_SERVER_BUSY){
+			if(matchID == ERROR_SERVER_FULL)
+				printf("Servidor lleno. Posicion en la cola: %d. Porfavor espere.\n", admission.queuePosition);
+			else
+				printf("Servidor ocupado. Porfavor espere.\n");
+			usleep(backoffDelay((matchID == ERROR_SERVER_FULL) ? 0 : attempt++, admission.retryAfter) * 1000);
 		}
 		else if(matchID == ERROR_PLAYER_REPEATED){
 			printf("Su nombre no puede ser igual al del otro jugador.\n");
+			askName = TRUE;
 		}
-	} while(matchID == ERROR_SERVER_FULL || matchID == ERROR_PLAYER_REPEATED);
+	} while(matchID == ERROR_SERVER_FULL || matchID == ERROR_SERVER_BUSY || matchID == ERROR_PLAYER_REPEATED);
 	printf("Bienvenido %s\n", playerName.msg);
 
 	// Start game
@@ -116,6 +137,13 @@ int main(int argc, char **argv){
 
 		// Get game status
 		soap_call_conecta4ns__getStatus(&soap, serverURL, "", playerName, matchID, &gameStatus);
+
+		// Too many requests, wait before asking again
+		if(gameStatus.code == ERROR_RATE_LIMITED){
+			usleep(BACKOFF_BASE_MS * 1000);
+			continue;
+		}
+
 		gameStatus.msgStruct.msg[gameStatus.msgStruct.__size] = '\0';
 		printBoard(gameStatus.board, gameStatus.msgStruct.msg);
 
@@ -129,6 +157,10 @@ int main(int argc, char **argv){
 		do{
 			unsigned int column = readMove();
 			soap_call_conecta4ns__insertChip(&soap, serverURL, "", playerName, matchID, column, &resCode);
+			while(resCode == ERROR_RATE_LIMITED){
+				usleep(BACKOFF_BASE_MS * 1000);
+				soap_call_conecta4ns__insertChip(&soap, serverURL, "", playerName, matchID, column, &resCode);
+			}
 			if(resCode == TURN_REPEAT)
 				printf("Columna %d llena. Inserta en una columna distinta\n", column);
 				
@@ -1,6 +1,7 @@
 #include "soapH.h"
 #include "conecta4.nsmap"
 #include "game.h"
+#include "transport.h"
 
 
 /**
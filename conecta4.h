@@ -16,6 +16,19 @@
 /** Player not found */
 #define ERROR_PLAYER_REPEATED -4000
 
+/** Server is overloaded. The request has been rejected without queueing the player */
+#define ERROR_SERVER_BUSY -5000
+
+/** Move rejected: it is not the turn of the player, or another move is being performed */
+#define ERROR_NOT_YOUR_TURN -6000
+
+/** Call rejected without being processed: the player is sending requests too fast */
+#define ERROR_RATE_LIMITED -7000
+
+/** Board string rejected: wrong length, unknown chips, floating chips, impossible chip counts or winners,
+    or no chip of the player that must move when both players have the same number of chips */
+#define ERROR_INVALID_BOARD -8000
+
 /** Code for performing a move */
 #define TURN_MOVE 70001
 
@@ -81,7 +94,89 @@ typedef struct tBlock{
 	xsd__string board;
 }conecta4ns__tBlock;
 
+/** Response to a register request */
+typedef struct tAdmission{
+	int code;
+	int queuePosition;
+	int retryAfter;
+}conecta4ns__tAdmission;
+
+/** List of games */
+typedef struct tGameList{
+	int __size;
+	int *gameId;
+}conecta4ns__tGameList;
+
+/** Status of one game in a batch */
+typedef struct tGameStatus{
+	int gameId;
+	conecta4ns__tBlock status;
+}conecta4ns__tGameStatus;
+
+/** Response to a batch of getStatus requests */
+typedef struct tStatusList{
+	int __size;
+	conecta4ns__tGameStatus *game;
+}conecta4ns__tStatusList;
+
+/** Move for one game in a batch */
+typedef struct tMoveRequest{
+	int gameId;
+	int column;
+}conecta4ns__tMoveRequest;
+
+/** Batch of moves */
+typedef struct tMoveList{
+	int __size;
+	conecta4ns__tMoveRequest *move;
+}conecta4ns__tMoveList;
+
+/** Result of one move in a batch. Moves out of turn get ERROR_NOT_YOUR_TURN, as in insertChip */
+typedef struct tMoveResult{
+	int gameId;
+	int resCode;
+}conecta4ns__tMoveResult;
+
+/** Response to a batch of moves */
+typedef struct tResultList{
+	int __size;
+	conecta4ns__tMoveResult *result;
+}conecta4ns__tResultList;
+
+/** Statistics of a player in the leaderboard */
+typedef struct tPlayerStats{
+	xsd__string name;
+	int wins;
+	int draws;
+	int losses;
+	int rating;
+}conecta4ns__tPlayerStats;
+
+/** Best players and rank of the caller */
+typedef struct tLeaderboard{
+	int rank;
+	conecta4ns__tPlayerStats caller;
+	int __size;
+	conecta4ns__tPlayerStats *player;
+}conecta4ns__tLeaderboard;
+
+/** Evaluation of a position */
+typedef struct tAnalysis{
+	int code;
+	int column;
+	int score;
+	int depth;
+	int cached;
+	int searchMicros;
+	conecta4ns__tPlayer player;
+}conecta4ns__tAnalysis;
+
 /** Web Services */
-int conecta4ns__register(conecta4ns__tMessage playerName, int *code);
+int conecta4ns__register(conecta4ns__tMessage playerName, conecta4ns__tAdmission* admission);
 int conecta4ns__getStatus(conecta4ns__tMessage playerName, int gameId, conecta4ns__tBlock* status);
-int conecta4ns__insertChip(conecta4ns__tMessage playerName, int matchID, int column, int* resCode);
\ No newline at end of file
+int conecta4ns__insertChip(conecta4ns__tMessage playerName, int matchID, int column, int* resCode);
+int conecta4ns__getServerStats(conecta4ns__tMessage* stats);
+int conecta4ns__getStatusBatch(conecta4ns__tMessage playerName, conecta4ns__tGameList gameList, int waitMillis, conecta4ns__tStatusList* statusList);
+int conecta4ns__insertChipBatch(conecta4ns__tMessage playerName, conecta4ns__tMoveList moveList, conecta4ns__tResultList* resultList);
+int conecta4ns__getLeaderboard(conecta4ns__tMessage playerName, int topK, conecta4ns__tLeaderboard* leaderboard);
+int conecta4ns__analyzePosition(int gameId, conecta4ns__tMessage board, int budgetMillis, conecta4ns__tAnalysis* analysis);
\ No newline at end of file
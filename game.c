@@ -44,6 +44,91 @@ void insertChip (xsd__string board, conecta4ns__tPlayer player, unsigned int col
 	board[cell] = c;
 }
 
+unsigned int getDropCell (xsd__string board, unsigned int column){
+
+    unsigned int cell = column;
+
+	// Get the first empty cell of the column
+	while ((cell < (BOARD_WIDTH * BOARD_HEIGHT)) && (board[cell] != EMPTY_CELL))
+		cell += BOARD_WIDTH;
+
+	return cell;
+}
+
+int playMoves (xsd__string board, const char *moves, conecta4ns__tPlayer *player){
+
+	for (int i = 0; moves[i] != 0; i++){
+
+		unsigned int column = moves[i] - '0';
+
+		// Not a column, full column or game already finished
+		if (!isdigit(moves[i]) || column >= BOARD_WIDTH || checkMove(board, column) == fullColumn_move)
+			return FALSE;
+		if (checkWinner(board, player1) || checkWinner(board, player2))
+			return FALSE;
+
+		insertChip(board, *player, column);
+		*player = (*player == player1) ? player2 : player1;
+	}
+
+	return TRUE;
+}
+
+int readBoard (const char *text, int length, xsd__string board, conecta4ns__tPlayer *player){
+
+    int chips[2] = {0, 0};
+    int winner1, winner2;
+
+	if (text == NULL || length < (BOARD_WIDTH * BOARD_HEIGHT) || length > (BOARD_WIDTH * BOARD_HEIGHT) + 1)
+		return FALSE;
+
+	for (int i = 0; i < (BOARD_WIDTH * BOARD_HEIGHT); i++){
+
+		if (text[i] == PLAYER_1_CHIP)
+			chips[player1]++;
+		else if (text[i] == PLAYER_2_CHIP)
+			chips[player2]++;
+		else if (text[i] != EMPTY_CELL && text[i] != '.')
+			return FALSE;
+
+		board[i] = (text[i] == '.') ? EMPTY_CELL : text[i];
+
+		// Chips cannot float over an empty cell
+		if (i >= BOARD_WIDTH && board[i] != EMPTY_CELL && board[i - BOARD_WIDTH] == EMPTY_CELL)
+			return FALSE;
+	}
+
+	// Players alternate, so they differ by one chip at most
+	if (chips[player1] - chips[player2] > 1 || chips[player2] - chips[player1] > 1)
+		return FALSE;
+
+	// The chip of the player that must move, if it has been sent
+	if (length > (BOARD_WIDTH * BOARD_HEIGHT)){
+		if (text[BOARD_WIDTH * BOARD_HEIGHT] == PLAYER_1_CHIP)
+			*player = player1;
+		else if (text[BOARD_WIDTH * BOARD_HEIGHT] == PLAYER_2_CHIP)
+			*player = player2;
+		else
+			return FALSE;
+
+		// The player with more chips has just moved
+		if (chips[*player] > chips[(*player == player1) ? player2 : player1])
+			return FALSE;
+	}
+	else if (chips[player1] == chips[player2])
+		return FALSE;
+	else
+		*player = (chips[player2] < chips[player1]) ? player2 : player1;
+
+	// Only the last player that moved can have four in a row
+	winner1 = checkWinner(board, player1);
+	winner2 = checkWinner(board, player2);
+	if ((winner1 && winner2) || (winner1 && *player == player1) || (winner2 && *player == player2))
+		return FALSE;
+
+	return TRUE;
+}
+
 int checkUp (xsd__string board, unsigned int cell, char c){
 
     int found = FALSE;
@@ -52,13 +137,13 @@ int checkUp (xsd__string board, unsigned int cell, char c){
 	if ((cell+BOARD_WIDTH) < (BOARD_WIDTH * BOARD_HEIGHT))
 		found = (board[cell+BOARD_WIDTH] == c);
 
-	// Check third chip
-	if (((cell+(2*BOARD_WIDTH)) < (BOARD_WIDTH * BOARD_HEIGHT)) && found)
-		found = (board[cell+(2*BOARD_WIDTH)] == c);
+	// Check third chip (a line that leaves the board is not a line)
+	if (found)
+		found = ((cell+(2*BOARD_WIDTH)) < (BOARD_WIDTH * BOARD_HEIGHT)) && (board[cell+(2*BOARD_WIDTH)] == c);
 
 	// Check fourth chip
-	if (((cell+(3*BOARD_WIDTH)) < (BOARD_WIDTH * BOARD_HEIGHT)) && found )
-		found = (board[cell+(3*BOARD_WIDTH)] == c);
+	if (found)
+		found = ((cell+(3*BOARD_WIDTH)) < (BOARD_WIDTH * BOARD_HEIGHT)) && (board[cell+(3*BOARD_WIDTH)] == c);
 
 	return found;
 }
@@ -66,19 +151,19 @@ int checkUp (xsd__string board, unsigned int cell, char c){
 int checkRight (xsd__string board, unsigned int cell, char c){
 
     int found = FALSE;
-    int limit = ((cell/BOARD_WIDTH) +1) * BOARD_WIDTH;
+    unsigned int limit = ((cell/BOARD_WIDTH) +1) * BOARD_WIDTH;
 		
 	// Check second chip
 	if ((cell+1) < limit)
 		found = (board[cell+1] == c);
 
-	// Check third chip
-	if (((cell+2) < limit) && found)
-		found = (board[cell+2] == c);
+	// Check third chip (a line that leaves the row is not a line)
+	if (found)
+		found = ((cell+2) < limit) && (board[cell+2] == c);
 
 	// Check fourth chip
-	if (((cell+3) < limit) && found )
-		found = (board[cell+3] == c);
+	if (found)
+		found = ((cell+3) < limit) && (board[cell+3] == c);
 
 	return found;
 }
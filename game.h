@@ -25,6 +25,47 @@ conecta4ns__tMove checkMove (xsd__string board, unsigned int column);
  */
 void insertChip (xsd__string board, conecta4ns__tPlayer player, unsigned int column);
 
+/**
+ * Gets the cell where a chip inserted in a column would land
+ *
+ * @param board Board of the game
+ * @param column Column to insert the chip
+ * @return Index of the cell, or BOARD_WIDTH * BOARD_HEIGHT if the column is full
+ */
+unsigned int getDropCell (xsd__string board, unsigned int column);
+
+/**
+ * Plays a sequence of moves on a board
+ *
+ * Each character of the sequence is a column number, and players alternate
+ * after each move.
+ *
+ * @param board Board of the game
+ * @param moves Sequence of columns, e.g. "3342"
+ * @param player Player that performs the first move. Updated with the player that must move next
+ * @return TRUE if every move is legal, or FALSE in another case
+ */
+int playMoves (xsd__string board, const char *moves, conecta4ns__tPlayer *player);
+
+/**
+ * Reads a board sent as text
+ *
+ * The text has one character per cell, in the order of the board (the first row is the bottom one),
+ * optionally followed by the chip of the player that must move. Empty cells may be sent as EMPTY_CELL
+ * or '.'. If a player has one chip more, the other one must move. If both have the same number, either
+ * of them may have started the game, so the chip of the player that must move is required.
+ *
+ * Boards where both players have four in a row, or where the winner is not the last player that moved,
+ * are rejected.
+ *
+ * @param text Cells of the board and chip of the player that must move
+ * @param length Length of the text
+ * @param board Where the board is stored
+ * @param player Where the player that must move is stored
+ * @return TRUE if the board is possible in a game, or FALSE in another case
+ */
+int readBoard (const char *text, int length, xsd__string board, conecta4ns__tPlayer *player);
+
 /**
  * Check if a player is the winner
  *
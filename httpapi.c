@@ -0,0 +1,253 @@
+#include "server.h"
+#include "httpapi.h"
+
+
+/**
+ * Gets the query of a request if its path is the given one
+ *
+ * @return Query without the '?', empty if there is none, or NULL if the path is another one
+ */
+static const char *matchPath (const char *path, const char *expected){
+
+    size_t length = strlen(expected);
+
+	if (strncmp(path, expected, length) != 0)
+		return NULL;
+
+	if (path[length] == 0)
+		return path + length;
+	if (path[length] == '?')
+		return path + length + 1;
+
+	return NULL;
+}
+
+static int hexValue (char c){
+
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+/**
+ * Reads a parameter of a query or a form, decoding '+' and %XX
+ *
+ * @return TRUE if the parameter is present, or FALSE in another case
+ */
+static int getParameter (const char *query, const char *key, char *value, size_t size){
+
+    size_t keyLength = strlen(key);
+    const char *p = query;
+
+	while (p != NULL && *p != 0){
+
+		if (strncmp(p, key, keyLength) == 0 && p[keyLength] == '='){
+
+			size_t n = 0;
+
+			for (p += keyLength + 1; *p != 0 && *p != '&' && n < size - 1; p++){
+				if (*p == '+')
+					value[n++] = ' ';
+				else if (*p == '%' && hexValue(p[1]) >= 0 && hexValue(p[2]) >= 0){
+					value[n++] = (char)(hexValue(p[1]) * 16 + hexValue(p[2]));
+					p += 2;
+				}
+				else
+					value[n++] = *p;
+			}
+
+			value[n] = 0;
+			return TRUE;
+		}
+
+		p = strchr(p, '&');
+		if (p != NULL)
+			p++;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Reads an integer parameter
+ *
+ * @return TRUE if the parameter is present and is a number, or FALSE in another case
+ */
+static int getIntParameter (const char *query, const char *key, int *value){
+
+    char text[16];
+    char *end;
+
+	if (!getParameter(query, key, text, sizeof(text)) || text[0] == 0)
+		return FALSE;
+
+	*value = (int) strtol(text, &end, 10);
+	return *end == 0;
+}
+
+static int isBareFormat (const char *query){
+
+    char format[8];
+
+	return getParameter(query, "format", format, sizeof(format)) && strcmp(format, HTTP_BARE_FORMAT) == 0;
+}
+
+/**
+ * Appends a string to a JSON document, with quotes and escapes
+ */
+static int appendJsonString (char *buffer, int length, const char *text, int size){
+
+    int n = 0;
+
+	if (n < length)
+		buffer[n++] = '"';
+
+	for (int i = 0; i < size && n < length - 7; i++){
+
+		unsigned char c = (unsigned char) text[i];
+
+		if (c == '"' || c == '\\'){
+			buffer[n++] = '\\';
+			buffer[n++] = c;
+		}
+		else if (c < 0x20)
+			n += snprintf(buffer + n, length - n, "\\u%04x", c);
+		else
+			buffer[n++] = c;
+	}
+
+	if (n < length)
+		buffer[n++] = '"';
+
+	return n;
+}
+
+int formatHttpStatus (char *buffer, int length, int gameId, conecta4ns__tBlock *status, int bare){
+
+    int n;
+
+	if (bare)
+		return snprintf(buffer, length, "%d\n%.*s\n", status->code,
+						(status->board != NULL) ? status->__size : 0, (status->board != NULL) ? status->board : "");
+
+	n = snprintf(buffer, length, "{\"game\":%d,\"code\":%d,\"message\":", gameId, status->code);
+	n += appendJsonString(buffer + n, length - n, (status->msgStruct).msg, (status->msgStruct).__size);
+	n += snprintf(buffer + n, length - n, ",\"board\":");
+	if (status->board != NULL)
+		n += appendJsonString(buffer + n, length - n, status->board, status->__size);
+	else
+		n += snprintf(buffer + n, length - n, "null");
+	n += snprintf(buffer + n, length - n, "}\n");
+
+	return (n < length) ? n : length - 1;
+}
+
+int sendHttpResponse (struct soap *soap, int bare, const char *body, int length){
+
+	soap->http_content = bare ? HTTP_BARE_CONTENT : HTTP_JSON_CONTENT;
+
+	if (soap_response(soap, SOAP_FILE) || soap_send_raw(soap, body, length) || soap_end_send(soap))
+		return soap->error;
+
+	return SOAP_OK;
+}
+
+/**
+ * Sends a result code without board, for the requests that cannot be served
+ */
+static int sendCode (struct soap *soap, int bare, int gameId, int code){
+
+    char buffer[HTTP_RESPONSE_LENGTH];
+    int length;
+
+	if (bare)
+		length = snprintf(buffer, sizeof(buffer), "%d\n", code);
+	else
+		length = snprintf(buffer, sizeof(buffer), "{\"game\":%d,\"code\":%d}\n", gameId, code);
+
+	return sendHttpResponse(soap, bare, buffer, length);
+}
+
+void useHttpFastPath (struct soap *soap){
+	soap->fget = httpGetStatus;
+	soap->fform = httpPostMove;
+}
+
+int httpGetStatus (struct soap *soap){
+
+    char playerName[STRING_LENGTH];
+    char buffer[HTTP_RESPONSE_LENGTH];
+    const char *query = matchPath(soap->path, HTTP_STATUS_PATH);
+    conecta4ns__tBlock status;
+    conecta4ns__tPlayer player;
+    int gameId, waitMillis;
+
+	// Other paths are rejected as gSOAP does without the fast path
+	if (query == NULL)
+		return SOAP_GET_METHOD;
+
+	int bare = isBareFormat(query);
+
+	if (!getIntParameter(query, "game", &gameId) || gameId < 0 || gameId >= MAX_GAMES)
+		return sendCode(soap, bare, -1, ERROR_WRONG_GAMEID);
+
+	// Unknown players are rejected without a board, as in getStatus
+	if (!getParameter(query, "player", playerName, sizeof(playerName)) || !findPlayer(playerName, gameId, &player))
+		return sendCode(soap, bare, gameId, ERROR_PLAYER_NOT_FOUND);
+
+	// Without a valid wait the player waits for the turn, as in getStatus
+	if (!getIntParameter(query, "wait", &waitMillis) || waitMillis < 0)
+		waitMillis = -1;
+	else if (waitMillis > MAX_BATCH_WAIT_MS)
+		waitMillis = MAX_BATCH_WAIT_MS;
+
+	// Turn and waiting responses are sent by serveStatus, from the status cache when possible
+	int result = serveStatus(soap, playerName, gameId, waitMillis, bare ? formatBare : formatJson, &status);
+	if (result != SOAP_OK)
+		return (result == SOAP_STOP) ? SOAP_OK : result;
+
+	return sendHttpResponse(soap, bare, buffer, formatHttpStatus(buffer, sizeof(buffer), gameId, &status, bare));
+}
+
+int httpPostMove (struct soap *soap){
+
+    char form[HTTP_FORM_LENGTH];
+    char playerName[STRING_LENGTH];
+    const char *query = matchPath(soap->path, HTTP_MOVE_PATH);
+    size_t length = 0;
+    int gameId, column;
+
+	// gSOAP answers with this HTTP status
+	if (query == NULL)
+		return HTTP_NOT_FOUND;
+
+	// Copy the form, so it is terminated and bounded
+	char *body = soap_get_http_body(soap, &length);
+	if (body == NULL)
+		length = 0;
+	if (length >= sizeof(form))
+		length = sizeof(form) - 1;
+	if (length > 0)
+		memcpy(form, body, length);
+	form[length] = 0;
+
+	int bare = isBareFormat(form);
+
+	if (!getIntParameter(form, "game", &gameId) || gameId < 0 || gameId >= MAX_GAMES)
+		return sendCode(soap, bare, -1, ERROR_WRONG_GAMEID);
+
+	// Empty names would match the free slots of a game
+	if (!getParameter(form, "player", playerName, sizeof(playerName)) || playerName[0] == 0)
+		return sendCode(soap, bare, gameId, ERROR_PLAYER_NOT_FOUND);
+
+	// A missing column is asked again
+	if (!getIntParameter(form, "column", &column))
+		column = -1;
+
+	return sendCode(soap, bare, gameId, requestMove(playerName, gameId, column));
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef HTTPAPI_H
+#define HTTPAPI_H
+
+#include "soapH.h"
+
+/** Path of the status requests: GET /status?game=ID&player=NAME[&wait=MS][&format=bare] */
+#define HTTP_STATUS_PATH "/status"
+
+/** Path of the moves: POST /move with the form game=ID&player=NAME&column=N[&format=bare] */
+#define HTTP_MOVE_PATH "/move"
+
+/** Value of the format parameter that selects the bare code and board instead of JSON */
+#define HTTP_BARE_FORMAT "bare"
+
+/** Content type of the JSON responses */
+#define HTTP_JSON_CONTENT "application/json"
+
+/** Content type of the bare responses */
+#define HTTP_BARE_CONTENT "text/plain"
+
+/** HTTP status of the form posts to unknown paths */
+#define HTTP_NOT_FOUND 404
+
+/** Maximum length of a response of the fast path */
+#define HTTP_RESPONSE_LENGTH 512
+
+/** Maximum length of the form of a move */
+#define HTTP_FORM_LENGTH 512
+
+/**
+ * Enables the HTTP/JSON fast path in a server context
+ *
+ * GET and form POST requests are answered by the hooks of gSOAP (fget and fform), and every
+ * context copied from this one inherits them. SOAP requests are served as before.
+ *
+ * @param soap Soap context of the server
+ */
+void useHttpFastPath (struct soap *soap);
+
+/**
+ * Writes the status of a game as JSON, or as the bare code and board
+ *
+ * @param buffer Where the response is written
+ * @param length Size of the buffer
+ * @param gameId ID of the game
+ * @param status Status of the game
+ * @param bare TRUE for the bare format, or FALSE for JSON
+ * @return Length of the response
+ */
+int formatHttpStatus (char *buffer, int length, int gameId, conecta4ns__tBlock *status, int bare);
+
+/**
+ * Sends a response of the fast path, with the content type of its format
+ *
+ * @param soap Soap context of the request
+ * @param bare TRUE for the bare format, or FALSE for JSON
+ * @param body Body of the response
+ * @param length Length of the body
+ * @return SOAP_OK if the response has been sent, or an error code of gSOAP
+ */
+int sendHttpResponse (struct soap *soap, int bare, const char *body, int length);
+
+/**
+ * Answers GET /status with the status of a game. Installed as soap->fget
+ *
+ * Waits for the turn of the player like getStatus, unless the wait parameter limits it.
+ *
+ * @param soap Soap context of the request
+ * @return SOAP_OK if the response has been sent, or an error code of gSOAP
+ */
+int httpGetStatus (struct soap *soap);
+
+/**
+ * Answers POST /move, performing the move of a player. Installed as soap->fform
+ *
+ * @param soap Soap context of the request
+ * @return SOAP_OK if the response has been sent, HTTP_NOT_FOUND for other paths, or an error code of gSOAP
+ */
+int httpPostMove (struct soap *soap);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,514 @@
+#include "leaderboard.h"
+#include <pthread.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Player of the leaderboard.
+ *
+ * Players are kept in a hash table by name and in a treap ordered by rating, where
+ * each node knows the size of its subtree so ranks are found in O(log n).
+ */
+typedef struct playerRecord{
+
+	tPlayerScore score;					/** Statistics of the player */
+	int id;								/** Interned ID, in order of arrival */
+	unsigned int priority;				/** Random priority of the node in the treap */
+	int size;							/** Number of nodes in the subtree */
+	struct playerRecord *left;			/** Players with a better rank */
+	struct playerRecord *right;			/** Players with a worse rank */
+	struct playerRecord *next;			/** Next player in the same hash bucket */
+}tPlayerRecord;
+
+/**
+ * Slot of the queue of finished games
+ */
+typedef struct resultSlot{
+
+	unsigned long sequence;				/** Position of the queue this slot is ready for */
+	char player1Name[STRING_LENGTH];	/** Name of player 1 */
+	char player2Name[STRING_LENGTH];	/** Name of player 2 */
+	tGameResult result;					/** Result of the game */
+}tResultSlot;
+
+/** Queue of finished games. Written by the game threads, read by the leaderboard thread */
+static tResultSlot resultQueue[LEADERBOARD_QUEUE_SIZE];
+
+/** Next position to be written in the queue */
+static unsigned long enqueuePos = 0;
+
+/** Next position to be read from the queue */
+static unsigned long dequeuePos = 0;
+
+/** Hash table of players */
+static tPlayerRecord **players = NULL;
+
+/** Number of buckets of the hash table */
+static int tableSize = 0;
+
+/** Number of players */
+static int numPlayers = 0;
+
+/** Root of the treap */
+static tPlayerRecord *root = NULL;
+
+/** Lock to read the leaderboard while the leaderboard thread updates it */
+static pthread_rwlock_t lockLeaderboard = PTHREAD_RWLOCK_INITIALIZER;
+
+/** Leaderboard thread */
+static pthread_t leaderboardTid;
+
+/** Flag to stop the leaderboard thread */
+static int running = FALSE;
+
+/** File where the snapshots are saved */
+static const char *snapshotPath = NULL;
+
+/** Number of results added */
+static unsigned long processedResults = 0;
+
+/** Number of results discarded */
+static unsigned long droppedResults = 0;
+
+/** State of the generator of priorities */
+static unsigned int prioritySeed = 1;
+
+
+/**
+ * Hash of a player name (FNV-1a)
+ */
+static unsigned int hashName (const char *name){
+
+    unsigned int hash = 2166136261u;
+
+	for (; *name; name++)
+		hash = (hash ^ (unsigned char) *name) * 16777619u;
+
+	return hash;
+}
+
+static int nodeSize (tPlayerRecord *node){
+	return node ? node->size : 0;
+}
+
+static void updateSize (tPlayerRecord *node){
+	node->size = 1 + nodeSize(node->left) + nodeSize(node->right);
+}
+
+/**
+ * Checks if a player has a better rank than another one: higher rating, or same rating and older
+ */
+static int precedes (tPlayerRecord *a, tPlayerRecord *b){
+	return (a->score.rating > b->score.rating) || (a->score.rating == b->score.rating && a->id < b->id);
+}
+
+/**
+ * Joins two treaps. Every node of left must precede every node of right
+ */
+static tPlayerRecord *merge (tPlayerRecord *left, tPlayerRecord *right){
+
+	if (left == NULL)
+		return right;
+	if (right == NULL)
+		return left;
+
+	if (left->priority > right->priority){
+		left->right = merge(left->right, right);
+		updateSize(left);
+		return left;
+	}
+
+	right->left = merge(left, right->left);
+	updateSize(right);
+	return right;
+}
+
+/**
+ * Splits a treap in the nodes that precede a player and the rest
+ */
+static void split (tPlayerRecord *tree, tPlayerRecord *player, tPlayerRecord **left, tPlayerRecord **right){
+
+	if (tree == NULL){
+		*left = *right = NULL;
+		return;
+	}
+
+	if (precedes(tree, player)){
+		split(tree->right, player, &tree->right, right);
+		*left = tree;
+	}
+	else{
+		split(tree->left, player, left, &tree->left);
+		*right = tree;
+	}
+
+	updateSize(tree);
+}
+
+static void insertRanked (tPlayerRecord *player){
+
+    tPlayerRecord *left, *right;
+
+	player->left = player->right = NULL;
+	player->size = 1;
+	split(root, player, &left, &right);
+	root = merge(merge(left, player), right);
+}
+
+static tPlayerRecord *eraseRanked (tPlayerRecord *tree, tPlayerRecord *player){
+
+	if (tree == player)
+		return merge(tree->left, tree->right);
+
+	if (precedes(player, tree))
+		tree->left = eraseRanked(tree->left, player);
+	else
+		tree->right = eraseRanked(tree->right, player);
+
+	updateSize(tree);
+	return tree;
+}
+
+/**
+ * Rank of a player in the treap (1 is the best)
+ */
+static int rankOf (tPlayerRecord *player){
+
+    tPlayerRecord *node = root;
+    int rank = 0;
+
+	while (node != NULL){
+
+		if (node == player)
+			return rank + nodeSize(node->left) + 1;
+
+		if (precedes(player, node))
+			node = node->left;
+		else{
+			rank += nodeSize(node->left) + 1;
+			node = node->right;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Copies the first players of a treap, in order
+ */
+static void collectTop (tPlayerRecord *node, tPlayerScore *top, int k, int *count){
+
+	if (node == NULL || *count >= k)
+		return;
+
+	collectTop(node->left, top, k, count);
+	if (*count < k)
+		top[(*count)++] = node->score;
+	collectTop(node->right, top, k, count);
+}
+
+static tPlayerRecord *findRecord (const char *name){
+
+    tPlayerRecord *player;
+
+	if (players == NULL)
+		return NULL;
+
+	for (player = players[hashName(name) & (tableSize - 1)]; player != NULL; player = player->next)
+		if (strcmp(player->score.name, name) == 0)
+			return player;
+
+	return NULL;
+}
+
+/**
+ * Doubles the size of the hash table
+ */
+static void growTable (){
+
+    int newSize = tableSize ? tableSize * 2 : LEADERBOARD_TABLE_SIZE;
+    tPlayerRecord **newTable = (tPlayerRecord**) calloc(newSize, sizeof(tPlayerRecord*));
+
+	for (int i = 0; i < tableSize; i++){
+		while (players[i] != NULL){
+			tPlayerRecord *player = players[i];
+			players[i] = player->next;
+			player->next = newTable[hashName(player->score.name) & (newSize - 1)];
+			newTable[hashName(player->score.name) & (newSize - 1)] = player;
+		}
+	}
+
+	free(players);
+	players = newTable;
+	tableSize = newSize;
+}
+
+/**
+ * Gets a player, creating it if it does not exist. Must be called with the write lock
+ */
+static tPlayerRecord *internPlayer (const char *name){
+
+    tPlayerRecord *player = findRecord(name);
+
+	if (player != NULL)
+		return player;
+
+	if (numPlayers >= tableSize)
+		growTable();
+
+	player = (tPlayerRecord*) calloc(1, sizeof(tPlayerRecord));
+	strncpy(player->score.name, name, STRING_LENGTH - 1);
+	player->score.rating = INITIAL_RATING;
+	player->id = numPlayers++;
+	player->priority = rand_r(&prioritySeed);
+
+	player->next = players[hashName(name) & (tableSize - 1)];
+	players[hashName(name) & (tableSize - 1)] = player;
+	insertRanked(player);
+
+	return player;
+}
+
+/**
+ * Updates the statistics and ratings of the players of a game. Must be called with the write lock
+ */
+static void applyResult (const char *player1Name, const char *player2Name, tGameResult result){
+
+    tPlayerRecord *player1, *player2;
+    double expected, score;
+    int delta;
+
+	if (strcmp(player1Name, player2Name) == 0)
+		return;
+
+	player1 = internPlayer(player1Name);
+	player2 = internPlayer(player2Name);
+
+	// Elo update
+	expected = 1.0 / (1.0 + pow(10.0, (player2->score.rating - player1->score.rating) / 400.0));
+	score = (result == resultPlayer1Wins) ? 1.0 : (result == resultDraw) ? 0.5 : 0.0;
+	delta = (int) lround(RATING_K_FACTOR * (score - expected));
+
+	root = eraseRanked(root, player1);
+	root = eraseRanked(root, player2);
+
+	player1->score.rating += delta;
+	player2->score.rating -= delta;
+
+	if (result == resultPlayer1Wins){
+		player1->score.wins++;
+		player2->score.losses++;
+	}
+	else if (result == resultPlayer2Wins){
+		player1->score.losses++;
+		player2->score.wins++;
+	}
+	else{
+		player1->score.draws++;
+		player2->score.draws++;
+	}
+
+	insertRanked(player1);
+	insertRanked(player2);
+}
+
+/**
+ * Adds every queued result to the leaderboard
+ *
+ * @return Number of results added
+ */
+static int applyQueuedResults (){
+
+    int count = 0;
+
+	pthread_rwlock_wrlock(&lockLeaderboard);
+
+	while (TRUE){
+
+		tResultSlot *slot = &resultQueue[dequeuePos & (LEADERBOARD_QUEUE_SIZE - 1)];
+
+		// The slot has not been written yet
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != dequeuePos + 1)
+			break;
+
+		applyResult(slot->player1Name, slot->player2Name, slot->result);
+		__atomic_store_n(&slot->sequence, dequeuePos + LEADERBOARD_QUEUE_SIZE, __ATOMIC_RELEASE);
+		dequeuePos++;
+		count++;
+	}
+
+	pthread_rwlock_unlock(&lockLeaderboard);
+
+	__sync_fetch_and_add(&processedResults, count);
+	return count;
+}
+
+/**
+ * Saves every player in the snapshot file
+ *
+ * Only the leaderboard thread modifies the players, so no lock is needed here.
+ */
+static void saveSnapshot (){
+
+    char tmpPath[STRING_LENGTH + 8];
+    FILE *file;
+
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", snapshotPath);
+	file = fopen(tmpPath, "w");
+
+	if (file == NULL){
+		perror("[Leaderboard] Cannot save the snapshot");
+		return;
+	}
+
+	for (int i = 0; i < tableSize; i++)
+		for (tPlayerRecord *player = players[i]; player != NULL; player = player->next)
+			fprintf(file, "%d %d %d %d %s\n", player->score.rating, player->score.wins,
+					player->score.draws, player->score.losses, player->score.name);
+
+	// Replace the previous snapshot only when the new one is complete
+	if (fclose(file) == 0)
+		rename(tmpPath, snapshotPath);
+}
+
+/**
+ * Loads the players of the last snapshot
+ */
+static void loadSnapshot (){
+
+    char line[STRING_LENGTH * 2];
+    FILE *file = fopen(snapshotPath, "r");
+    tPlayerScore score;
+
+	if (file == NULL)
+		return;
+
+	while (fgets(line, sizeof(line), file) != NULL){
+
+		memset(&score, 0, sizeof(tPlayerScore));
+		if (sscanf(line, "%d %d %d %d %127[^\n]", &score.rating, &score.wins, &score.draws, &score.losses, score.name) != 5)
+			continue;
+
+		tPlayerRecord *player = internPlayer(score.name);
+		root = eraseRanked(root, player);
+		player->score = score;
+		insertRanked(player);
+	}
+
+	fclose(file);
+}
+
+static void *leaderboardThread (void *arg){
+
+    time_t lastSnapshot = time(NULL);
+    int pending = FALSE;
+
+	// The queue and the table are globals, so the thread has no argument
+	(void) arg;
+
+	while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)){
+
+		if (applyQueuedResults() > 0)
+			pending = TRUE;
+		else
+			usleep(LEADERBOARD_POLL_MS * 1000);
+
+		if (pending && (time(NULL) - lastSnapshot) >= LEADERBOARD_SNAPSHOT_SECONDS){
+			saveSnapshot();
+			lastSnapshot = time(NULL);
+			pending = FALSE;
+		}
+	}
+
+	applyQueuedResults();
+	saveSnapshot();
+
+	return NULL;
+}
+
+void initLeaderboard (const char *path){
+
+	snapshotPath = path;
+	prioritySeed = (unsigned int) time(NULL);
+
+	// Every slot is ready for its first position
+	for (unsigned long i = 0; i < LEADERBOARD_QUEUE_SIZE; i++)
+		resultQueue[i].sequence = i;
+
+	growTable();
+	loadSnapshot();
+
+	running = TRUE;
+	pthread_create(&leaderboardTid, NULL, leaderboardThread, NULL);
+}
+
+void stopLeaderboard (){
+
+	__atomic_store_n(&running, FALSE, __ATOMIC_RELEASE);
+	pthread_join(leaderboardTid, NULL);
+}
+
+int recordGameResult (const char *player1Name, const char *player2Name, tGameResult result){
+
+    unsigned long pos = __atomic_load_n(&enqueuePos, __ATOMIC_RELAXED);
+    tResultSlot *slot;
+
+	// Bounded lock-free queue: claim a position with compare-and-swap
+	while (TRUE){
+
+		slot = &resultQueue[pos & (LEADERBOARD_QUEUE_SIZE - 1)];
+		long diff = (long) __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - (long) pos;
+
+		if (diff == 0){
+			if (__atomic_compare_exchange_n(&enqueuePos, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff < 0){
+			__sync_fetch_and_add(&droppedResults, 1);
+			return FALSE;
+		}
+		else
+			pos = __atomic_load_n(&enqueuePos, __ATOMIC_RELAXED);
+	}
+
+	strncpy(slot->player1Name, player1Name, STRING_LENGTH - 1);
+	slot->player1Name[STRING_LENGTH - 1] = 0;
+	strncpy(slot->player2Name, player2Name, STRING_LENGTH - 1);
+	slot->player2Name[STRING_LENGTH - 1] = 0;
+	slot->result = result;
+
+	// Publish the slot to the leaderboard thread
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+int queryLeaderboard (const char *playerName, int k, tPlayerScore *top, int *numTop, tPlayerScore *score){
+
+    tPlayerRecord *player;
+    int rank = 0;
+
+	*numTop = 0;
+	memset(score, 0, sizeof(tPlayerScore));
+
+	pthread_rwlock_rdlock(&lockLeaderboard);
+
+	collectTop(root, top, k, numTop);
+
+	player = findRecord(playerName);
+	if (player != NULL){
+		*score = player->score;
+		rank = rankOf(player);
+	}
+
+	pthread_rwlock_unlock(&lockLeaderboard);
+
+	return rank;
+}
+
+void getLeaderboardCounters (int *players, unsigned long *processed, unsigned long *dropped){
+	*players = numPlayers;
+	*processed = processedResults;
+	*dropped = droppedResults;
+}
\ No newline at end of file
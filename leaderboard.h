@@ -0,0 +1,90 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include "soapH.h"
+
+/** File where the leaderboard is saved */
+#define LEADERBOARD_FILE "leaderboard.dat"
+
+/** Seconds between two snapshots of the leaderboard */
+#define LEADERBOARD_SNAPSHOT_SECONDS 60
+
+/** Number of finished games that can wait to be added (must be a power of two) */
+#define LEADERBOARD_QUEUE_SIZE 1024
+
+/** Milliseconds the leaderboard thread sleeps when there are no finished games */
+#define LEADERBOARD_POLL_MS 50
+
+/** Initial size of the table of players (must be a power of two) */
+#define LEADERBOARD_TABLE_SIZE 1024
+
+/** Maximum number of players returned by a top-K query */
+#define LEADERBOARD_MAX_TOP 100
+
+/** Rating of a new player */
+#define INITIAL_RATING 1500
+
+/** Maximum change of rating after a game */
+#define RATING_K_FACTOR 32
+
+/** Result of a game, from the point of view of player 1 */
+typedef enum { resultPlayer1Wins, resultDraw, resultPlayer2Wins } tGameResult;
+
+/**
+ * Statistics of a player
+ */
+typedef struct playerScore{
+
+	char name[STRING_LENGTH];			/** Name of the player */
+	int wins;							/** Number of games won */
+	int draws;							/** Number of draw games */
+	int losses;							/** Number of games lost */
+	int rating;							/** Elo rating */
+}tPlayerScore;
+
+/**
+ * Loads the last snapshot and starts the thread that updates the leaderboard
+ *
+ * @param path File where the snapshots are saved
+ */
+void initLeaderboard (const char *path);
+
+/**
+ * Stops the leaderboard thread and saves a last snapshot
+ */
+void stopLeaderboard ();
+
+/**
+ * Adds the result of a finished game to the leaderboard
+ *
+ * Never blocks: the result is queued without locks, and it is discarded if the queue is full.
+ *
+ * @param player1Name Name of player 1
+ * @param player2Name Name of player 2
+ * @param result Result of the game
+ * @return TRUE if the result has been queued, or FALSE in another case
+ */
+int recordGameResult (const char *player1Name, const char *player2Name, tGameResult result);
+
+/**
+ * Reads the best players and the rank of one player
+ *
+ * @param playerName Name of the player whose rank is requested
+ * @param k Number of players requested
+ * @param top Where the best players are stored, at least k elements
+ * @param numTop Number of players stored in top
+ * @param score Where the statistics of the player are stored
+ * @return Rank of the player (1 is the best), or 0 if the player has no finished games
+ */
+int queryLeaderboard (const char *playerName, int k, tPlayerScore *top, int *numTop, tPlayerScore *score);
+
+/**
+ * Gets the counters of the leaderboard
+ *
+ * @param players Number of players with finished games
+ * @param processed Number of results added
+ * @param dropped Number of results discarded because the queue was full
+ */
+void getLeaderboardCounters (int *players, unsigned long *processed, unsigned long *dropped);
+
+#endif
\ No newline at end of file
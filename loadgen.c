@@ -0,0 +1,273 @@
+#include "soapH.h"
+#include "conecta4.nsmap"
+#include "game.h"
+#include "transport.h"
+#include <pthread.h>
+#include <time.h>
+
+/** Operations measured by the load generator */
+typedef enum { opRegister, opGetStatus, opInsertChip, opPing, NUM_OPS } tOperation;
+
+/** Names of the operations */
+static const char *opNames[NUM_OPS] = { "register", "getStatus", "insertChip", "ping" };
+
+/**
+ * Latencies of one operation (in microseconds)
+ */
+typedef struct latencies{
+
+	double *samples;					/** Measured latencies */
+	int count;							/** Number of samples */
+	int capacity;						/** Size of the samples array */
+}tLatencies;
+
+/**
+ * Thread of the load generator
+ */
+typedef struct bot{
+
+	int id;								/** Number of the bot */
+	char *endpoint;						/** Endpoint of the server */
+	int count;							/** Number of pings or games */
+	int finished;						/** Number of games played to the end */
+	int errors;							/** Number of failed calls */
+	int throttled;						/** Number of calls rejected by the rate limits */
+	tLatencies latency[NUM_OPS];		/** Latencies of each operation */
+}tBot;
+
+
+double nowMicroseconds (){
+
+    struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+void addSample (tLatencies *latency, double value){
+
+	if (latency->count == latency->capacity){
+		latency->capacity = latency->capacity ? latency->capacity * 2 : 1024;
+		latency->samples = (double*) realloc(latency->samples, latency->capacity * sizeof(double));
+	}
+
+	latency->samples[latency->count++] = value;
+}
+
+int compareDoubles (const void *a, const void *b){
+
+    double x = *(const double*) a, y = *(const double*) b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Measures the round trip of getServerStats, which does no game work
+ */
+void *pingBot (void *arg){
+
+    tBot *bot = (tBot*) arg;
+    struct soap soap;
+    conecta4ns__tMessage stats;
+    char *endpoint = bot->endpoint;
+
+	soap_init(&soap);
+	useUnixEndpoint(&soap, &endpoint);
+
+	for (int i = 0; i < bot->count; i++){
+
+		double start = nowMicroseconds();
+
+		if (soap_call_conecta4ns__getServerStats(&soap, endpoint, "", &stats) != SOAP_OK)
+			bot->errors++;
+		else
+			addSample(&bot->latency[opPing], nowMicroseconds() - start);
+
+		soap_end(&soap);
+	}
+
+	soap_done(&soap);
+	return NULL;
+}
+
+/**
+ * Plays games with random moves
+ */
+void *playBot (void *arg){
+
+    tBot *bot = (tBot*) arg;
+    struct soap soap;
+    conecta4ns__tMessage playerName;
+    conecta4ns__tAdmission admission;
+    conecta4ns__tBlock status;
+    char *endpoint = bot->endpoint;
+    unsigned int seed = bot->id * 7919 + time(NULL);
+    double start;
+    int resCode;
+
+	soap_init(&soap);
+	useUnixEndpoint(&soap, &endpoint);
+	playerName.msg = (xsd__string) malloc(STRING_LENGTH);
+
+	for (int game = 0; game < bot->count; game++){
+
+		unsigned int attempt = 0;
+		int endOfGame = FALSE;
+
+		playerName.__size = snprintf(playerName.msg, STRING_LENGTH, "bot%d-%d", bot->id, game);
+
+		// Register, waiting while the server is full
+		do{
+			start = nowMicroseconds();
+			if (soap_call_conecta4ns__register(&soap, endpoint, "", playerName, &admission) != SOAP_OK){
+				bot->errors++;
+				admission.code = ERROR_SERVER_BUSY;
+				admission.retryAfter = 0;
+			}
+			else
+				addSample(&bot->latency[opRegister], nowMicroseconds() - start);
+
+			// Queued players follow the hint of their position, the others back off
+			if (admission.code == ERROR_SERVER_FULL)
+				usleep(backoffDelay(0, admission.retryAfter) * 1000);
+			else if (admission.code == ERROR_SERVER_BUSY)
+				usleep(backoffDelay(attempt++, admission.retryAfter) * 1000);
+
+			soap_end(&soap);
+		} while (admission.code == ERROR_SERVER_FULL || admission.code == ERROR_SERVER_BUSY);
+
+		if (admission.code < 0){
+			bot->errors++;
+			continue;
+		}
+
+		int matchID = admission.code;
+
+		while (!endOfGame){
+
+			start = nowMicroseconds();
+			if (soap_call_conecta4ns__getStatus(&soap, endpoint, "", playerName, matchID, &status) != SOAP_OK){
+				bot->errors++;
+				break;
+			}
+			addSample(&bot->latency[opGetStatus], nowMicroseconds() - start);
+
+			if (status.code == ERROR_RATE_LIMITED){
+				bot->throttled++;
+				usleep(BACKOFF_BASE_MS * 1000);
+				soap_end(&soap);
+				continue;
+			}
+
+			if (status.code == GAMEOVER_WIN || status.code == GAMEOVER_DRAW || status.code == GAMEOVER_LOSE || status.board == NULL){
+				if (status.code == GAMEOVER_WIN || status.code == GAMEOVER_DRAW || status.code == GAMEOVER_LOSE)
+					bot->finished++;
+				endOfGame = TRUE;
+				continue;
+			}
+
+			// Random move in a column that is not full
+			resCode = TURN_REPEAT;
+			do{
+				unsigned int column = rand_r(&seed) % BOARD_WIDTH;
+
+				if (checkMove(status.board, column) == fullColumn_move)
+					continue;
+
+				start = nowMicroseconds();
+				if (soap_call_conecta4ns__insertChip(&soap, endpoint, "", playerName, matchID, column, &resCode) != SOAP_OK){
+					bot->errors++;
+					endOfGame = TRUE;
+					break;
+				}
+				addSample(&bot->latency[opInsertChip], nowMicroseconds() - start);
+
+				if (resCode == ERROR_RATE_LIMITED){
+					bot->throttled++;
+					usleep(BACKOFF_BASE_MS * 1000);
+				}
+
+			} while (resCode == TURN_REPEAT || resCode == TURN_MOVE || resCode == ERROR_RATE_LIMITED);
+
+			soap_end(&soap);
+		}
+	}
+
+	free(playerName.msg);
+	soap_end(&soap);
+	soap_done(&soap);
+	return NULL;
+}
+
+int main(int argc, char **argv){
+
+    int threads, count, isPing, errors = 0, throttled = 0, finished = 0;
+    tLatencies total[NUM_OPS];
+    double start, seconds;
+
+	if (argc != 5 || (strcmp(argv[2], "ping") != 0 && strcmp(argv[2], "play") != 0)){
+		printf("Usage: %s http://server:port | unix:/path/to/socket ping|play threads count\n", argv[0]);
+		printf("  ping: each thread sends count getServerStats requests\n");
+		printf("  play: each thread plays count games with random moves (use an even number of threads)\n");
+		printf("  Start the server with C4_PEER_RATE=0 C4_SESSION_RATE=0 to measure it without rate limits\n");
+		exit(0);
+	}
+
+	isPing = (strcmp(argv[2], "ping") == 0);
+	threads = atoi(argv[3]);
+	count = atoi(argv[4]);
+
+	tBot bots[threads];
+	pthread_t tid[threads];
+
+	memset(bots, 0, sizeof(bots));
+	memset(total, 0, sizeof(total));
+
+	start = nowMicroseconds();
+	for (int i = 0; i < threads; i++){
+		bots[i].id = i;
+		bots[i].endpoint = argv[1];
+		bots[i].count = count;
+		pthread_create(&tid[i], NULL, isPing ? pingBot : playBot, &bots[i]);
+	}
+	for (int i = 0; i < threads; i++)
+		pthread_join(tid[i], NULL);
+	seconds = (nowMicroseconds() - start) / 1e6;
+
+	// Merge the samples of every thread
+	for (int i = 0; i < threads; i++){
+		errors += bots[i].errors;
+		throttled += bots[i].throttled;
+		finished += bots[i].finished;
+		for (int op = 0; op < NUM_OPS; op++){
+			for (int j = 0; j < bots[i].latency[op].count; j++)
+				addSample(&total[op], bots[i].latency[op].samples[j]);
+			free(bots[i].latency[op].samples);
+		}
+	}
+
+	printf("%-10s %9s %10s %10s %10s %10s\n", "operation", "calls", "mean(us)", "p50(us)", "p99(us)", "calls/s");
+	for (int op = 0; op < NUM_OPS; op++){
+
+		tLatencies *latency = &total[op];
+		double sum = 0;
+
+		if (latency->count == 0)
+			continue;
+
+		qsort(latency->samples, latency->count, sizeof(double), compareDoubles);
+		for (int j = 0; j < latency->count; j++)
+			sum += latency->samples[j];
+
+		printf("%-10s %9d %10.1f %10.1f %10.1f %10.0f\n", opNames[op], latency->count, sum / latency->count,
+			   latency->samples[latency->count / 2], latency->samples[(latency->count * 99) / 100], latency->count / seconds);
+		free(latency->samples);
+	}
+	printf("%d errors, %d throttled calls in %.2f s\n", errors, throttled, seconds);
+
+	// Goodput: each game is finished by both of its players
+	if (!isPing)
+		printf("%d games finished (%.1f games/s)\n", finished / 2, finished / (2 * seconds));
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,388 @@
+#include "mcts.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/** Half points of a won playout */
+#define MCTS_WIN_POINTS 2
+
+/** Half points of a drawn playout */
+#define MCTS_DRAW_POINTS 1
+
+/** Winner of a playout that ended in a draw */
+#define MCTS_NO_WINNER -1
+
+/** Maximum length of a path from the root */
+#define MCTS_MAX_DEPTH (BOARD_WIDTH * BOARD_HEIGHT + 1)
+
+/**
+ * State shared by the threads of one search
+ */
+typedef struct mctsSearch{
+
+	tMcts *mcts;						/** Engine */
+	char board[BOARD_WIDTH * BOARD_HEIGHT];	/** Board at the root */
+	conecta4ns__tPlayer player;			/** Player that moves at the root */
+	struct timespec deadline;			/** End of the time budget */
+	int timed;							/** The search has a time budget */
+	unsigned long maxPlayouts;			/** Playouts budget, or 0 */
+	unsigned long playouts;				/** Playouts finished by every thread */
+	int arenaFull;						/** A node could not be expanded */
+	int stop;							/** The budget is over */
+}tMctsSearch;
+
+/**
+ * Thread of a search
+ */
+typedef struct mctsWorker{
+
+	tMctsSearch *search;				/** Search shared with the other threads */
+	uint64_t seed;						/** State of the random number generator */
+}tMctsWorker;
+
+
+static conecta4ns__tPlayer otherPlayer (conecta4ns__tPlayer player){
+	return (player == player1) ? player2 : player1;
+}
+
+/**
+ * xorshift64* generator, one state per thread
+ */
+static unsigned int randomNumber (uint64_t *state){
+
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+
+	return (unsigned int)((*state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static int budgetOver (tMctsSearch *search){
+
+    struct timespec now;
+
+	if (search->maxPlayouts && __atomic_load_n(&search->playouts, __ATOMIC_RELAXED) >= search->maxPlayouts)
+		return TRUE;
+
+	if (!search->timed)
+		return FALSE;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec > search->deadline.tv_sec) ||
+		   (now.tv_sec == search->deadline.tv_sec && now.tv_nsec >= search->deadline.tv_nsec);
+}
+
+/**
+ * Takes the children of a node from the arena. The node must be marked as expanding by the caller.
+ */
+static int expandNode (tMcts *mcts, tMctsNode *node, xsd__string board){
+
+    unsigned char columns[BOARD_WIDTH];
+    unsigned int count = 0;
+
+	for (int column = 0; column < BOARD_WIDTH; column++)
+		if (checkMove(board, column) == OK_move)
+			columns[count++] = column;
+
+	unsigned int first = __atomic_fetch_add(&mcts->used, count, __ATOMIC_RELAXED);
+	if (first + count > mcts->capacity){
+		__atomic_store_n(&node->expansion, mctsLeaf, __ATOMIC_RELAXED);
+		return FALSE;
+	}
+
+	for (unsigned int i = 0; i < count; i++){
+		memset(&mcts->nodes[first + i], 0, sizeof(tMctsNode));
+		mcts->nodes[first + i].column = columns[i];
+	}
+
+	node->firstChild = first;
+	node->numChildren = count;
+
+	// Children are visible to other threads only when they are initialized
+	__atomic_store_n(&node->expansion, mctsExpanded, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+/**
+ * Selects the child with the highest UCT value. Virtual loss counts as visits without points,
+ * so threads searching at the same time spread over different branches.
+ */
+static unsigned int selectChild (tMcts *mcts, tMctsNode *node){
+
+    unsigned int best = node->firstChild;
+    double bestValue = -1.0;
+    int parentVisits = __atomic_load_n(&node->visits, __ATOMIC_RELAXED) + __atomic_load_n(&node->virtualLoss, __ATOMIC_RELAXED);
+    double logVisits = log(parentVisits > 1 ? parentVisits : 1);
+
+	for (unsigned int i = node->firstChild; i < node->firstChild + node->numChildren; i++){
+
+		tMctsNode *child = &mcts->nodes[i];
+		int visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED) + __atomic_load_n(&child->virtualLoss, __ATOMIC_RELAXED);
+
+		// Untried moves and winning moves first
+		if (visits == 0 || __atomic_load_n(&child->terminal, __ATOMIC_RELAXED) == mctsWon)
+			return i;
+
+		double value = __atomic_load_n(&child->score, __ATOMIC_RELAXED) / (double)(MCTS_WIN_POINTS * visits) +
+					   mcts->exploration * sqrt(logVisits / visits);
+
+		if (value > bestValue){
+			bestValue = value;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * Plays random moves until the game ends. Guided playouts take a winning move when there is one.
+ */
+static int playout (xsd__string board, conecta4ns__tPlayer player, int guided, uint64_t *seed){
+
+    unsigned int columns[BOARD_WIDTH];
+
+	while (!isBoardFull(board)){
+
+		unsigned int count = 0;
+		int column = -1;
+
+		for (unsigned int c = 0; c < BOARD_WIDTH; c++)
+			if (checkMove(board, c) == OK_move)
+				columns[count++] = c;
+
+		if (guided){
+			char chip = (player == player1) ? PLAYER_1_CHIP : PLAYER_2_CHIP;
+
+			for (unsigned int i = 0; i < count && column < 0; i++){
+				unsigned int cell = getDropCell(board, columns[i]);
+				board[cell] = chip;
+				if (checkWinner(board, player))
+					column = columns[i];
+				board[cell] = EMPTY_CELL;
+			}
+		}
+
+		if (column < 0)
+			column = columns[randomNumber(seed) % count];
+
+		insertChip(board, player, column);
+		if (checkWinner(board, player))
+			return player;
+
+		player = otherPlayer(player);
+	}
+
+	return MCTS_NO_WINNER;
+}
+
+/**
+ * One iteration: selection and expansion down the shared tree, a playout, and backpropagation
+ */
+static void runIteration (tMctsSearch *search, uint64_t *seed){
+
+    tMcts *mcts = search->mcts;
+    char board[BOARD_WIDTH * BOARD_HEIGHT];
+    unsigned int path[MCTS_MAX_DEPTH];
+    conecta4ns__tPlayer player = search->player;
+    int depth = 0, winner = MCTS_NO_WINNER, decided = FALSE;
+
+	memcpy(board, search->board, BOARD_WIDTH * BOARD_HEIGHT);
+	path[0] = 0;
+	__atomic_fetch_add(&mcts->nodes[0].virtualLoss, mcts->virtualLoss, __ATOMIC_RELAXED);
+
+	for (;;){
+
+		tMctsNode *node = &mcts->nodes[path[depth]];
+		unsigned char expansion = __atomic_load_n(&node->expansion, __ATOMIC_ACQUIRE);
+
+		// Leaves are expanded by the first thread that visits them enough times
+		if (expansion == mctsLeaf && __atomic_load_n(&node->visits, __ATOMIC_RELAXED) >= MCTS_EXPAND_VISITS &&
+			__atomic_load_n(&mcts->used, __ATOMIC_RELAXED) < mcts->capacity){
+
+			unsigned char expected = mctsLeaf;
+
+			if (__atomic_compare_exchange_n(&node->expansion, &expected, mctsExpanding, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+				if (expandNode(mcts, node, board))
+					expansion = mctsExpanded;
+				else
+					__atomic_store_n(&search->arenaFull, TRUE, __ATOMIC_RELAXED);
+			}
+		}
+
+		if (expansion != mctsExpanded)
+			break;
+
+		unsigned int index = selectChild(mcts, node);
+		tMctsNode *child = &mcts->nodes[index];
+
+		__atomic_fetch_add(&child->virtualLoss, mcts->virtualLoss, __ATOMIC_RELAXED);
+		insertChip(board, player, child->column);
+		path[++depth] = index;
+
+		// The result of a finished position is stored in its node the first time it is found
+		unsigned char terminal = __atomic_load_n(&child->terminal, __ATOMIC_RELAXED);
+		if (terminal == mctsOpen){
+			if (checkWinner(board, player))
+				terminal = mctsWon;
+			else if (isBoardFull(board))
+				terminal = mctsDrawn;
+
+			if (terminal != mctsOpen)
+				__atomic_store_n(&child->terminal, terminal, __ATOMIC_RELAXED);
+		}
+
+		if (terminal != mctsOpen){
+			winner = (terminal == mctsWon) ? (int) player : MCTS_NO_WINNER;
+			decided = TRUE;
+			break;
+		}
+
+		player = otherPlayer(player);
+	}
+
+	if (!decided)
+		winner = playout(board, player, mcts->guided, seed);
+
+	// Points are given to the player that moved into each node
+	for (int i = 0; i <= depth; i++){
+
+		tMctsNode *node = &mcts->nodes[path[i]];
+		conecta4ns__tPlayer mover = (i % 2) ? search->player : otherPlayer(search->player);
+		int points = (winner == MCTS_NO_WINNER) ? MCTS_DRAW_POINTS : ((winner == (int) mover) ? MCTS_WIN_POINTS : 0);
+
+		if (points)
+			__atomic_fetch_add(&node->score, points, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&node->visits, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&node->virtualLoss, mcts->virtualLoss, __ATOMIC_RELAXED);
+	}
+}
+
+static void *searchWorker (void *arg){
+
+    tMctsWorker *worker = (tMctsWorker*) arg;
+    tMctsSearch *search = worker->search;
+
+	while (!__atomic_load_n(&search->stop, __ATOMIC_RELAXED)){
+
+		for (int i = 0; i < MCTS_CLOCK_INTERVAL; i++)
+			runIteration(search, &worker->seed);
+
+		__atomic_fetch_add(&search->playouts, MCTS_CLOCK_INTERVAL, __ATOMIC_RELAXED);
+		if (budgetOver(search))
+			__atomic_store_n(&search->stop, TRUE, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+int mctsInit (tMcts *mcts, unsigned int capacity){
+
+	// The root and its children always fit
+	if (capacity < BOARD_WIDTH + 1)
+		capacity = BOARD_WIDTH + 1;
+
+	mcts->nodes = (tMctsNode*) malloc(capacity * sizeof(tMctsNode));
+	if (mcts->nodes == NULL)
+		return FALSE;
+
+	mcts->capacity = capacity;
+	mcts->used = 0;
+	mcts->exploration = MCTS_DEFAULT_EXPLORATION;
+	mcts->virtualLoss = MCTS_DEFAULT_VIRTUAL_LOSS;
+	mcts->guided = TRUE;
+
+	return TRUE;
+}
+
+void mctsFree (tMcts *mcts){
+	free(mcts->nodes);
+	mcts->nodes = NULL;
+	mcts->capacity = 0;
+	mcts->used = 0;
+}
+
+int mctsBestMove (tMcts *mcts, xsd__string board, conecta4ns__tPlayer player, int threads,
+				  int budgetMillis, unsigned long maxPlayouts, tMctsStats *stats, double *winRate){
+
+    tMctsSearch search;
+    tMctsWorker workers[MCTS_MAX_THREADS];
+    pthread_t tid[MCTS_MAX_THREADS];
+    struct timespec start;
+    int best = -1, bestVisits = -1;
+
+	if (threads < 1)
+		threads = 1;
+	if (threads > MCTS_MAX_THREADS)
+		threads = MCTS_MAX_THREADS;
+
+	memset(&search, 0, sizeof(tMctsSearch));
+	search.mcts = mcts;
+	memcpy(search.board, board, BOARD_WIDTH * BOARD_HEIGHT);
+	search.player = player;
+	search.maxPlayouts = maxPlayouts;
+
+	// Without any budget the threads would never stop
+	if (budgetMillis <= 0 && maxPlayouts == 0)
+		budgetMillis = MCTS_DEFAULT_BUDGET_MS;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (budgetMillis > 0){
+		search.timed = TRUE;
+		search.deadline.tv_sec = start.tv_sec + budgetMillis / 1000;
+		search.deadline.tv_nsec = start.tv_nsec + (budgetMillis % 1000) * 1000000L;
+		if (search.deadline.tv_nsec >= 1000000000L){
+			search.deadline.tv_sec++;
+			search.deadline.tv_nsec -= 1000000000L;
+		}
+	}
+
+	// Reuse the arena: the tree of the previous move is discarded
+	mcts->used = 1;
+	memset(&mcts->nodes[0], 0, sizeof(tMctsNode));
+	mcts->nodes[0].expansion = mctsExpanding;
+	expandNode(mcts, &mcts->nodes[0], search.board);
+
+	if (mcts->nodes[0].numChildren > 0){
+
+		for (int i = 0; i < threads; i++){
+			workers[i].search = &search;
+			workers[i].seed = ((uint64_t) start.tv_nsec ^ ((uint64_t)(i + 1) * 0x9E3779B97F4A7C15ULL)) | 1;
+		}
+
+		// The calling thread is one of the workers
+		for (int i = 1; i < threads; i++)
+			pthread_create(&tid[i], NULL, searchWorker, &workers[i]);
+		searchWorker(&workers[0]);
+		for (int i = 1; i < threads; i++)
+			pthread_join(tid[i], NULL);
+
+		// The most visited move is the most robust choice
+		tMctsNode *root = &mcts->nodes[0];
+		for (unsigned int i = root->firstChild; i < root->firstChild + root->numChildren; i++){
+			if (mcts->nodes[i].visits > bestVisits){
+				bestVisits = mcts->nodes[i].visits;
+				best = i;
+			}
+		}
+	}
+
+	if (winRate != NULL)
+		*winRate = (best >= 0 && bestVisits > 0) ? mcts->nodes[best].score / (double)(MCTS_WIN_POINTS * bestVisits) : 0.0;
+
+	if (stats != NULL){
+		struct timespec end;
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		stats->playouts = search.playouts;
+		stats->nodes = (mcts->used < mcts->capacity) ? mcts->used : mcts->capacity;
+		stats->arenaFull = search.arenaFull;
+		stats->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	}
+
+	return (best >= 0) ? mcts->nodes[best].column : -1;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include "game.h"
+#include <stddef.h>
+
+/** Default number of nodes of the arena */
+#define MCTS_DEFAULT_NODES (1 << 20)
+
+/** Default exploration constant of UCT (sqrt(2)) */
+#define MCTS_DEFAULT_EXPLORATION 1.41421356
+
+/** Default visits added to a node while a thread is searching below it */
+#define MCTS_DEFAULT_VIRTUAL_LOSS 3
+
+/** Visits of a leaf before it is expanded */
+#define MCTS_EXPAND_VISITS 2
+
+/** Playouts between two checks of the clock */
+#define MCTS_CLOCK_INTERVAL 64
+
+/** Time budget used when neither a time budget nor a playouts budget is given (in milliseconds) */
+#define MCTS_DEFAULT_BUDGET_MS 1000
+
+/** Maximum number of search threads */
+#define MCTS_MAX_THREADS 64
+
+/** Expansion state of a node */
+typedef enum { mctsLeaf, mctsExpanding, mctsExpanded } tMctsExpansion;
+
+/** Result of a position already decided, seen by the player that moved into it */
+typedef enum { mctsOpen, mctsWon, mctsDrawn } tMctsTerminal;
+
+/**
+ * Node of the tree. The children of a node are contiguous in the arena.
+ *
+ * Every field is read and written with atomic operations, so many threads share the tree without locks.
+ */
+typedef struct mctsNode{
+
+	unsigned int firstChild;			/** Index of the first child in the arena */
+	unsigned char numChildren;			/** Number of children */
+	unsigned char column;				/** Move that leads to this node */
+	unsigned char expansion;			/** Expansion state (tMctsExpansion) */
+	unsigned char terminal;				/** Result of the position (tMctsTerminal) */
+	int visits;							/** Finished playouts through this node */
+	int virtualLoss;					/** Visits of the playouts still running below this node */
+	int score;							/** Half points won by the player that moved into this node */
+}tMctsNode;
+
+/**
+ * Monte Carlo tree search engine. The arena is allocated once and reused by every search.
+ */
+typedef struct mcts{
+
+	tMctsNode *nodes;					/** Arena of nodes. The root is the first one */
+	unsigned int capacity;				/** Number of nodes of the arena */
+	unsigned int used;					/** Nodes taken by the current search */
+	double exploration;					/** Exploration constant of UCT */
+	int virtualLoss;					/** Visits added to a node while a thread is below it */
+	int guided;							/** Playouts take immediate wins instead of random moves */
+}tMcts;
+
+/**
+ * Counters of a search
+ */
+typedef struct mctsStats{
+
+	unsigned long playouts;				/** Number of finished playouts */
+	unsigned int nodes;					/** Nodes taken from the arena */
+	int arenaFull;						/** The arena was exhausted during the search */
+	double seconds;						/** Duration of the search */
+}tMctsStats;
+
+/**
+ * Allocates the arena of an engine and sets the default parameters
+ *
+ * @param mcts Engine to be initialized
+ * @param capacity Number of nodes of the arena
+ * @return TRUE if the arena has been allocated, or FALSE in another case
+ */
+int mctsInit (tMcts *mcts, unsigned int capacity);
+
+/**
+ * Frees the arena of an engine
+ *
+ * @param mcts Engine to be freed
+ */
+void mctsFree (tMcts *mcts);
+
+/**
+ * Searches the best move for a player, sharing one tree among several threads
+ *
+ * The arena is cleared at the start, so the previous tree is discarded.
+ *
+ * @param mcts Engine
+ * @param board Board of the game
+ * @param player Player that must move
+ * @param threads Number of search threads
+ * @param budgetMillis Time budget (in milliseconds), or 0 to use only the playouts budget
+ * @param maxPlayouts Stop after this number of playouts, or 0 to use only the time budget.
+ *                    Without any budget the search stops after MCTS_DEFAULT_BUDGET_MS
+ * @param stats Counters of the search, or NULL
+ * @param winRate Expected result of the best move for player (0 = loss, 1 = win), or NULL
+ * @return Column of the best move, or -1 if there is no legal move
+ */
+int mctsBestMove (tMcts *mcts, xsd__string board, conecta4ns__tPlayer player, int threads,
+				  int budgetMillis, unsigned long maxPlayouts, tMctsStats *stats, double *winRate);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "soapH.h"
+#include "conecta4.nsmap"
+#include "mcts.h"
+#include <unistd.h>
+
+/** Default time budget of each search (in milliseconds) */
+#define DEFAULT_BUDGET_MS 1000
+
+/** Positions searched by the benchmark, as moves from the empty board */
+static const char *positions[] = { "", "3", "32", "3324", "2345" };
+
+/** Number of positions */
+#define NUM_POSITIONS (sizeof(positions) / sizeof(positions[0]))
+
+
+int main(int argc, char **argv){
+
+    tMcts mcts;
+    char board[BOARD_WIDTH * BOARD_HEIGHT];
+    int budget = (argc > 1) ? atoi(argv[1]) : DEFAULT_BUDGET_MS;
+    int maxThreads = (argc > 2) ? atoi(argv[2]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    int nodes = (argc > 3) ? atoi(argv[3]) : MCTS_DEFAULT_NODES;
+    double basePlayouts = 0.0;
+    int exhausted = FALSE;
+
+	if (budget < 1 || maxThreads < 1 || maxThreads > MCTS_MAX_THREADS || nodes < 1){
+		printf("Usage: %s [budget ms] [max threads] [arena nodes]\n", argv[0]);
+		exit(0);
+	}
+
+	if (!mctsInit(&mcts, nodes))
+		showError("[mctsbench] Cannot allocate the arena");
+
+	printf("Searching %d positions for %d ms each, arena of %d nodes (%.1f MB)\n",
+		   (int) NUM_POSITIONS, budget, nodes, nodes * sizeof(tMctsNode) / (1024.0 * 1024.0));
+	printf("%7s %12s %12s %9s %10s %10s  %s\n", "threads", "playouts", "playouts/s", "speed-up", "efficiency", "max nodes", "moves");
+
+	// The same arena is reused by every search
+	for (int threads = 1; threads <= maxThreads; threads++){
+
+		unsigned long playouts = 0;
+		unsigned int maxNodes = 0;
+		double seconds = 0.0;
+		int arenaFull = FALSE;
+		char moves[NUM_POSITIONS + 1];
+
+		for (int i = 0; i < (int) NUM_POSITIONS; i++){
+
+			conecta4ns__tPlayer player = player1;
+			tMctsStats stats;
+
+			initBoard(board);
+			playMoves(board, positions[i], &player);
+
+			int column = mctsBestMove(&mcts, board, player, threads, budget, 0, &stats, NULL);
+			moves[i] = (column >= 0) ? '0' + column : '-';
+
+			playouts += stats.playouts;
+			seconds += stats.seconds;
+			arenaFull |= stats.arenaFull;
+			if (stats.nodes > maxNodes)
+				maxNodes = stats.nodes;
+		}
+		moves[NUM_POSITIONS] = 0;
+
+		double rate = playouts / seconds;
+		if (threads == 1)
+			basePlayouts = rate;
+
+		printf("%7d %12lu %12.0f %8.2fx %9.0f%% %10u%s  %s\n", threads, playouts, rate, rate / basePlayouts,
+			   100.0 * rate / (basePlayouts * threads), maxNodes, arenaFull ? "*" : " ", moves);
+		exhausted |= arenaFull;
+	}
+
+	if (exhausted)
+		printf("(* the arena was exhausted; leaves were not expanded any more)\n");
+
+	mctsFree(&mcts);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "soapH.h"
+#include "conecta4.nsmap"
+#include "zobrist.h"
+#include <pthread.h>
+#include <time.h>
+
+/** Default number of threads */
+#define DEFAULT_THREADS 4
+
+/** Depth of the prefixes of the tree shared among threads */
+#define SPLIT_DEPTH 3
+
+/** Maximum number of prefixes (BOARD_WIDTH ^ SPLIT_DEPTH) */
+#define MAX_TASKS (BOARD_WIDTH * BOARD_WIDTH * BOARD_WIDTH)
+
+/**
+ * Counters of a subtree
+ */
+typedef struct perftCounts{
+
+	uint64_t leaves;					/** Positions at the requested depth */
+	uint64_t nodes;						/** Positions at any depth */
+	uint64_t wins[2];					/** Positions won by each player */
+	uint64_t draws;						/** Positions with a full board and no winner */
+}tPerftCounts;
+
+/**
+ * Entry of the table of subtrees. The key is stored as key ^ counters, so torn entries never match
+ */
+typedef struct perftEntry{
+
+	uint64_t check;						/** Key of the subtree xor counters */
+	tPerftCounts counts;				/** Counters of the subtree */
+	uint64_t padding[2];				/** Fill the cache line */
+}__attribute__((aligned(64))) tPerftEntry;
+
+/**
+ * Subtree to be counted by one thread
+ */
+typedef struct perftTask{
+
+	char board[BOARD_WIDTH * BOARD_HEIGHT];	/** Board at the root of the subtree */
+	conecta4ns__tPlayer player;			/** Player that must move */
+	tHash hash;							/** Hash of the board */
+	int depth;							/** Remaining depth */
+}tPerftTask;
+
+/** Tasks to be shared among threads */
+tPerftTask tasks[MAX_TASKS];
+
+/** Number of tasks */
+int numTasks = 0;
+
+/** Next task to be taken */
+int nextTask = 0;
+
+/** Table of subtrees, or NULL to count without it */
+tPerftEntry *table = NULL;
+
+/** Number of entries in the table - 1 */
+uint64_t tableMask = 0;
+
+/** Counters of the whole tree */
+tPerftCounts total;
+
+/** Number of subtrees found in the table */
+uint64_t tableHits = 0;
+
+/** Number of subtrees looked for in the table */
+uint64_t tableProbes = 0;
+
+/** Mutex to add the counters of each thread */
+pthread_mutex_t mutexTotal = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Adds the counters of a subtree
+ */
+void addCounts (tPerftCounts *to, tPerftCounts *from){
+	to->leaves += from->leaves;
+	to->nodes += from->nodes;
+	to->wins[player1] += from->wins[player1];
+	to->wins[player2] += from->wins[player2];
+	to->draws += from->draws;
+}
+
+/**
+ * Checksum of the counters of a subtree
+ */
+uint64_t countsChecksum (tPerftCounts *counts){
+	return counts->leaves ^ counts->nodes ^ counts->wins[player1] ^ counts->wins[player2] ^ counts->draws;
+}
+
+/**
+ * Key of a subtree: the same position at a different depth is a different subtree
+ */
+tHash subtreeKey (tHash hash, int depth){
+	return hash ^ ((uint64_t) depth * 0xD6E8FEB86659FD93ULL);
+}
+
+/**
+ * Counts the positions of a subtree
+ *
+ * The position at the root must not be terminal and depth must be at least 1.
+ */
+void perft (xsd__string board, conecta4ns__tPlayer player, tHash hash, int depth, tPerftCounts *counts, uint64_t *probes, uint64_t *hits){
+
+    tPerftEntry *entry = NULL;
+    conecta4ns__tPlayer other = (player == player1) ? player2 : player1;
+    tPerftCounts sub;
+
+	// Transpositions of an already counted subtree are read from the table
+	if (table != NULL && depth > 1){
+
+		tHash key = subtreeKey(hash, depth);
+		entry = &table[key & tableMask];
+
+		uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+		sub.leaves = __atomic_load_n(&entry->counts.leaves, __ATOMIC_RELAXED);
+		sub.nodes = __atomic_load_n(&entry->counts.nodes, __ATOMIC_RELAXED);
+		sub.wins[player1] = __atomic_load_n(&entry->counts.wins[player1], __ATOMIC_RELAXED);
+		sub.wins[player2] = __atomic_load_n(&entry->counts.wins[player2], __ATOMIC_RELAXED);
+		sub.draws = __atomic_load_n(&entry->counts.draws, __ATOMIC_RELAXED);
+
+		(*probes)++;
+		if (sub.nodes != 0 && (check ^ countsChecksum(&sub)) == key){
+			(*hits)++;
+			addCounts(counts, &sub);
+			return;
+		}
+	}
+
+	memset(&sub, 0, sizeof(tPerftCounts));
+
+	for (unsigned int column = 0; column < BOARD_WIDTH; column++){
+
+		if (checkMove(board, column) == fullColumn_move)
+			continue;
+
+		unsigned int cell = insertChipHashed(board, player, column, &hash);
+		sub.nodes++;
+
+		if (checkWinner(board, player)){
+			sub.wins[player]++;
+			sub.leaves += (depth == 1);
+		}
+		else if (isBoardFull(board)){
+			sub.draws++;
+			sub.leaves += (depth == 1);
+		}
+		else if (depth == 1)
+			sub.leaves++;
+		else
+			perft(board, other, hash, depth - 1, &sub, probes, hits);
+
+		removeChipHashed(board, player, cell, &hash);
+	}
+
+	if (entry != NULL){
+		tHash key = subtreeKey(hash, depth);
+		__atomic_store_n(&entry->check, key ^ countsChecksum(&sub), __ATOMIC_RELAXED);
+		__atomic_store_n(&entry->counts.leaves, sub.leaves, __ATOMIC_RELAXED);
+		__atomic_store_n(&entry->counts.nodes, sub.nodes, __ATOMIC_RELAXED);
+		__atomic_store_n(&entry->counts.wins[player1], sub.wins[player1], __ATOMIC_RELAXED);
+		__atomic_store_n(&entry->counts.wins[player2], sub.wins[player2], __ATOMIC_RELAXED);
+		__atomic_store_n(&entry->counts.draws, sub.draws, __ATOMIC_RELAXED);
+	}
+
+	addCounts(counts, &sub);
+}
+
+/**
+ * Splits the first levels of the tree in tasks. Positions of these levels are counted here
+ */
+void createTasks (xsd__string board, conecta4ns__tPlayer player, tHash hash, int depth, int split){
+
+    conecta4ns__tPlayer other = (player == player1) ? player2 : player1;
+
+	if (split == 0){
+		memcpy(tasks[numTasks].board, board, BOARD_WIDTH * BOARD_HEIGHT);
+		tasks[numTasks].player = player;
+		tasks[numTasks].hash = hash;
+		tasks[numTasks].depth = depth;
+		numTasks++;
+		return;
+	}
+
+	for (unsigned int column = 0; column < BOARD_WIDTH; column++){
+
+		if (checkMove(board, column) == fullColumn_move)
+			continue;
+
+		unsigned int cell = insertChipHashed(board, player, column, &hash);
+		total.nodes++;
+
+		if (checkWinner(board, player)){
+			total.wins[player]++;
+			total.leaves += (depth == 1);
+		}
+		else if (isBoardFull(board)){
+			total.draws++;
+			total.leaves += (depth == 1);
+		}
+		else if (depth == 1)
+			total.leaves++;
+		else
+			createTasks(board, other, hash, depth - 1, split - 1);
+
+		removeChipHashed(board, player, cell, &hash);
+	}
+}
+
+void *perftThread (void *arg){
+
+    tPerftCounts counts;
+    uint64_t probes = 0, hits = 0;
+    int i;
+
+	// Tasks are taken from the shared list, so the thread has no argument
+	(void) arg;
+
+	memset(&counts, 0, sizeof(tPerftCounts));
+
+	while ((i = __sync_fetch_and_add(&nextTask, 1)) < numTasks)
+		perft(tasks[i].board, tasks[i].player, tasks[i].hash, tasks[i].depth, &counts, &probes, &hits);
+
+	pthread_mutex_lock(&mutexTotal);
+	addCounts(&total, &counts);
+	tableProbes += probes;
+	tableHits += hits;
+	pthread_mutex_unlock(&mutexTotal);
+
+	return NULL;
+}
+
+int main(int argc, char **argv){
+
+    char board[BOARD_WIDTH * BOARD_HEIGHT];
+    conecta4ns__tPlayer player = player1;
+    struct timespec start, end;
+    int depth, threads, megabytes;
+    const char *moves;
+
+	if (argc < 2){
+		printf("Usage: %s depth [moves] [threads] [table MB]\n", argv[0]);
+		printf("  moves: columns played from the empty board, player 1 first (\"-\" for none)\n");
+		exit(0);
+	}
+
+	depth = atoi(argv[1]);
+	moves = (argc > 2 && strcmp(argv[2], "-") != 0) ? argv[2] : "";
+	threads = (argc > 3) ? atoi(argv[3]) : DEFAULT_THREADS;
+	megabytes = (argc > 4) ? atoi(argv[4]) : 0;
+
+	if (depth < 1 || threads < 1 || megabytes < 0){
+		printf("Wrong arguments\n");
+		exit(0);
+	}
+
+	// Starting position
+	initZobrist();
+	initBoard(board);
+	if (!playMoves(board, moves, &player)){
+		printf("Wrong sequence of moves: %s\n", moves);
+		exit(0);
+	}
+
+	// Table of subtrees
+	if (megabytes > 0){
+		uint64_t entries = 1;
+		while ((entries * 2 * sizeof(tPerftEntry)) <= ((uint64_t) megabytes * 1024 * 1024))
+			entries *= 2;
+		table = (tPerftEntry*) aligned_alloc(64, entries * sizeof(tPerftEntry));
+		if (table == NULL)
+			showError("[perft] Cannot allocate the table");
+		memset(table, 0, entries * sizeof(tPerftEntry));
+		tableMask = entries - 1;
+	}
+
+	memset(&total, 0, sizeof(tPerftCounts));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Count the positions, unless the game has already finished
+	if (!checkWinner(board, player1) && !checkWinner(board, player2) && !isBoardFull(board)){
+
+		pthread_t tid[threads];
+
+		createTasks(board, player, hashBoard(board, player), depth, (depth > SPLIT_DEPTH) ? SPLIT_DEPTH : depth - 1);
+
+		for (int i = 0; i < threads; i++)
+			pthread_create(&tid[i], NULL, perftThread, NULL);
+		for (int i = 0; i < threads; i++)
+			pthread_join(tid[i], NULL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("perft(%d) = %llu\n", depth, (unsigned long long) total.leaves);
+	printf("Nodes: %llu, player 1 wins: %llu, player 2 wins: %llu, draws: %llu\n",
+		   (unsigned long long) total.nodes, (unsigned long long) total.wins[player1],
+		   (unsigned long long) total.wins[player2], (unsigned long long) total.draws);
+	printf("Time: %.3f s, %.0f nodes/s with %d threads\n", seconds, total.nodes / seconds, threads);
+	if (table != NULL)
+		printf("Table: %llu probes, %.1f%% hits\n", (unsigned long long) tableProbes,
+			   tableProbes ? (100.0 * tableHits) / tableProbes : 0.0);
+
+	free(table);
+	return 0;
+}
\ No newline at end of file
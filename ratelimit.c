@@ -0,0 +1,171 @@
+#include "ratelimit.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Token bucket of a peer or a session
+ */
+typedef struct tokenBucket{
+
+	uint64_t key;						/** Hash of the peer or the session */
+	uint64_t lastRefill;				/** Time of the last refill (in nanoseconds), or 0 if unused */
+	double tokens;						/** Available tokens */
+}tTokenBucket;
+
+/**
+ * Set-associative table of buckets. Each lock protects the sets whose index matches its stripe
+ */
+typedef struct bucketTable{
+
+	tTokenBucket sets[RATE_TABLE_SETS][RATE_SET_ENTRIES];	/** Buckets */
+	pthread_mutex_t locks[RATE_LOCK_STRIPES];				/** Locks of the sets */
+	tRateLimit limit;										/** Limits of the buckets */
+	unsigned long throttled;								/** Rejected calls */
+}tBucketTable;
+
+/** Buckets of the peers */
+static tBucketTable peers;
+
+/** Buckets of the sessions */
+static tBucketTable sessions;
+
+
+static uint64_t nowNanoseconds (){
+
+    struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Final mix of splitmix64, so consecutive addresses fall in different sets
+ */
+static uint64_t mixKey (uint64_t key){
+
+	key ^= key >> 30;
+	key *= 0xBF58476D1CE4E5B9ULL;
+	key ^= key >> 27;
+	key *= 0x94D049BB133111EBULL;
+	key ^= key >> 31;
+
+	return key;
+}
+
+/**
+ * Reads a limit from the environment, keeping the default value if it is missing or wrong
+ */
+static double readLimit (const char *name, double defaultValue){
+
+    const char *value = getenv(name);
+    char *end;
+
+	if (value == NULL || *value == 0)
+		return defaultValue;
+
+	double limit = strtod(value, &end);
+	if (*end != 0 || limit < 0){
+		fprintf(stderr, "Ignoring %s=%s\n", name, value);
+		return defaultValue;
+	}
+
+	return limit;
+}
+
+static void initTable (tBucketTable *table, double perSecond, double burst){
+
+	memset(table->sets, 0, sizeof(table->sets));
+	for (int i = 0; i < RATE_LOCK_STRIPES; i++)
+		pthread_mutex_init(&table->locks[i], NULL);
+
+	// A burst below one token would reject every call
+	table->limit.perSecond = perSecond;
+	table->limit.burst = (burst < 1) ? 1 : burst;
+	table->throttled = 0;
+}
+
+/**
+ * Refills the bucket of a key and takes one token from it
+ */
+static int takeToken (tBucketTable *table, uint64_t key){
+
+	if (table->limit.perSecond <= 0)
+		return TRUE;
+
+    uint64_t now = nowNanoseconds();
+    unsigned int set = key & (RATE_TABLE_SETS - 1);
+    tTokenBucket *entries = table->sets[set];
+    tTokenBucket *bucket = NULL;
+    int allowed;
+
+	pthread_mutex_lock(&table->locks[set & (RATE_LOCK_STRIPES - 1)]);
+
+	// Find the bucket of the key, or the least recently used one of the set
+	for (int i = 0; i < RATE_SET_ENTRIES && bucket == NULL; i++)
+		if (entries[i].lastRefill != 0 && entries[i].key == key)
+			bucket = &entries[i];
+
+	if (bucket == NULL){
+		bucket = &entries[0];
+		for (int i = 1; i < RATE_SET_ENTRIES; i++)
+			if (entries[i].lastRefill < bucket->lastRefill)
+				bucket = &entries[i];
+
+		bucket->key = key;
+		bucket->tokens = table->limit.burst;
+		bucket->lastRefill = now;
+	}
+
+	bucket->tokens += (now - bucket->lastRefill) * table->limit.perSecond / 1e9;
+	if (bucket->tokens > table->limit.burst)
+		bucket->tokens = table->limit.burst;
+	bucket->lastRefill = now;
+
+	allowed = (bucket->tokens >= 1.0);
+	if (allowed)
+		bucket->tokens -= 1.0;
+
+	pthread_mutex_unlock(&table->locks[set & (RATE_LOCK_STRIPES - 1)]);
+
+	if (!allowed)
+		__sync_fetch_and_add(&table->throttled, 1);
+
+	return allowed;
+}
+
+void initRateLimits (){
+
+	initTable(&peers, readLimit(RATE_PEER_PER_SECOND_ENV, RATE_PEER_PER_SECOND),
+			  readLimit(RATE_PEER_BURST_ENV, RATE_PEER_BURST));
+	initTable(&sessions, readLimit(RATE_SESSION_PER_SECOND_ENV, RATE_SESSION_PER_SECOND),
+			  readLimit(RATE_SESSION_BURST_ENV, RATE_SESSION_BURST));
+}
+
+int allowPeer (unsigned long address){
+	return takeToken(&peers, mixKey(address));
+}
+
+int allowSession (const char *playerName, int gameId){
+
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+	// FNV-1a of the name, mixed with the game
+	for (const unsigned char *c = (const unsigned char*) playerName; *c != 0; c++){
+		hash ^= *c;
+		hash *= 0x100000001B3ULL;
+	}
+
+	return takeToken(&sessions, mixKey(hash ^ (uint64_t)(unsigned int) gameId));
+}
+
+void getRateLimits (tRateLimit *peer, tRateLimit *session){
+	*peer = peers.limit;
+	*session = sessions.limit;
+}
+
+void getRateLimitCounters (unsigned long *peerThrottled, unsigned long *sessionThrottled){
+	*peerThrottled = peers.throttled;
+	*sessionThrottled = sessions.throttled;
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include "soapH.h"
+#include <stdint.h>
+
+/** Default requests per second of each peer (0 disables the limit) */
+#define RATE_PEER_PER_SECOND 200
+
+/** Default burst of requests of each peer */
+#define RATE_PEER_BURST 400
+
+/** Default calls per second of each session, that is, a player in a game (0 disables the limit) */
+#define RATE_SESSION_PER_SECOND 20
+
+/** Default burst of calls of each session */
+#define RATE_SESSION_BURST 40
+
+/** Environment variables that override the default limits */
+#define RATE_PEER_PER_SECOND_ENV "C4_PEER_RATE"
+#define RATE_PEER_BURST_ENV "C4_PEER_BURST"
+#define RATE_SESSION_PER_SECOND_ENV "C4_SESSION_RATE"
+#define RATE_SESSION_BURST_ENV "C4_SESSION_BURST"
+
+/** Number of sets of each table of buckets (must be a power of two) */
+#define RATE_TABLE_SETS 1024
+
+/** Buckets of each set. A new key replaces the least recently used bucket of its set */
+#define RATE_SET_ENTRIES 4
+
+/** Number of locks of each table (must be a power of two) */
+#define RATE_LOCK_STRIPES 64
+
+/** Address given to the peers connected through the Unix domain socket. They have no peer limit */
+#define RATE_LOCAL_PEER 0
+
+/**
+ * Limits of one kind of bucket
+ */
+typedef struct rateLimit{
+
+	double perSecond;					/** Tokens added per second */
+	double burst;						/** Maximum number of tokens */
+}tRateLimit;
+
+/**
+ * Reads the limits from the environment and clears the buckets
+ */
+void initRateLimits ();
+
+/**
+ * Takes a token from the bucket of a peer. Called for every request of a TCP connection
+ *
+ * Local peers are not limited here: every frontend behind the Unix domain socket would share
+ * one bucket and throttle the others. Their players are still limited by the session buckets.
+ *
+ * @param address IPv4 address of the peer
+ * @return TRUE if the connection is allowed, or FALSE if the peer is over its limit
+ */
+int allowPeer (unsigned long address);
+
+/**
+ * Takes a token from the bucket of a session. Called by the handlers before any game work
+ *
+ * Only for players registered in the game: every new key takes a bucket, so names made up
+ * by the caller would evict the buckets of real sessions. Other calls are only limited by
+ * the bucket of their peer.
+ *
+ * @param playerName Name of the player
+ * @param gameId ID of the game
+ * @return TRUE if the call is allowed, or FALSE if the session is over its limit
+ */
+int allowSession (const char *playerName, int gameId);
+
+/**
+ * Gets the limits in use
+ *
+ * @param peer Limits of the peers
+ * @param session Limits of the sessions
+ */
+void getRateLimits (tRateLimit *peer, tRateLimit *session);
+
+/**
+ * Gets the number of rejected calls
+ *
+ * @param peerThrottled Connections rejected because the peer was over its limit
+ * @param sessionThrottled Calls rejected because the session was over its limit
+ */
+void getRateLimitCounters (unsigned long *peerThrottled, unsigned long *sessionThrottled);
+
+#endif
\ No newline at end of file
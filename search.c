@@ -0,0 +1,256 @@
+#include "search.h"
+
+/** Order used to try the moves: center columns first */
+static const int moveOrder[BOARD_WIDTH] = {3, 2, 4, 1, 5, 0, 6};
+
+/** Value of a chip in each column for the static evaluation */
+static const int columnWeight[BOARD_WIDTH] = {1, 2, 3, 4, 3, 2, 1};
+
+
+/**
+ * Converts a score to be stored in the transposition table
+ *
+ * Win scores depend on the distance to the root, so they are stored as distance to this position.
+ */
+static int scoreToTable (int score, int ply){
+
+	if (score > SEARCH_WIN_THRESHOLD)
+		return score + ply;
+	if (score < -SEARCH_WIN_THRESHOLD)
+		return score - ply;
+
+	return score;
+}
+
+/**
+ * Converts a score read from the transposition table
+ */
+static int scoreFromTable (int score, int ply){
+
+	if (score > SEARCH_WIN_THRESHOLD)
+		return score - ply;
+	if (score < -SEARCH_WIN_THRESHOLD)
+		return score + ply;
+
+	return score;
+}
+
+/**
+ * Static evaluation of a position: chips in the central columns are worth more
+ */
+static int evaluate (xsd__string board, conecta4ns__tPlayer player){
+
+    char own = (player == player1) ? PLAYER_1_CHIP : PLAYER_2_CHIP;
+    int score = 0;
+
+	for (int i = 0; i < (BOARD_WIDTH * BOARD_HEIGHT); i++){
+		if (board[i] == own)
+			score += columnWeight[i % BOARD_WIDTH];
+		else if (board[i] != EMPTY_CELL)
+			score -= columnWeight[i % BOARD_WIDTH];
+	}
+
+	return score;
+}
+
+/**
+ * Checks the deadline of a timed search every few nodes
+ */
+static int timeIsOver (tSearchStats *stats){
+
+    struct timespec now;
+
+	if (stats->aborted)
+		return TRUE;
+	if (!stats->timed || (stats->nodes & SEARCH_CLOCK_MASK) != 0)
+		return FALSE;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec > stats->deadline.tv_sec ||
+		(now.tv_sec == stats->deadline.tv_sec && now.tv_nsec >= stats->deadline.tv_nsec))
+		stats->aborted = TRUE;
+
+	return stats->aborted;
+}
+
+/**
+ * Negamax search with alpha-beta pruning
+ *
+ * @param bestColumn Where the best move is stored, or NULL
+ */
+static int negamax (xsd__string board, conecta4ns__tPlayer player, tHash hash, int depth, int ply,
+					int alpha, int beta, tTTable *table, tSearchStats *stats, int *bestColumn){
+
+    int alphaOrig = alpha;
+    int best = -SEARCH_WIN_SCORE - 1;
+    int bestMove = TT_NO_MOVE;
+    int ttMove = TT_NO_MOVE;
+    int moves[BOARD_WIDTH];
+    int numMoves = 0;
+
+	stats->nodes++;
+
+	// The score of an aborted search is discarded by the caller
+	if (timeIsOver(stats))
+		return 0;
+
+	// Look for the position in the transposition table
+	if (table != NULL){
+
+		int ttScore, ttDepth, move;
+		tBound bound;
+
+		// A best move that is not legal means that the entry belongs to another position
+		if (ttProbe(table, hash, &ttScore, &ttDepth, &bound, &move, &stats->tt)){
+
+			if (move != TT_NO_MOVE && checkMove(board, move) == fullColumn_move){
+				stats->tt.hits--;
+				stats->tt.collisions++;
+			}
+			else{
+				ttMove = move;
+
+				if (ttDepth >= depth && bestColumn == NULL){
+					ttScore = scoreFromTable(ttScore, ply);
+					if (bound == ttExact)
+						return ttScore;
+					if (bound == ttLower && ttScore > alpha)
+						alpha = ttScore;
+					else if (bound == ttUpper && ttScore < beta)
+						beta = ttScore;
+					if (alpha >= beta)
+						return ttScore;
+				}
+			}
+		}
+	}
+
+	if (depth == 0)
+		return evaluate(board, player);
+
+	// Move from the table first, then center columns first
+	if (ttMove != TT_NO_MOVE)
+		moves[numMoves++] = ttMove;
+	for (int i = 0; i < BOARD_WIDTH; i++)
+		if (moveOrder[i] != ttMove)
+			moves[numMoves++] = moveOrder[i];
+
+	for (int i = 0; (i < numMoves) && (alpha < beta); i++){
+
+		int column = moves[i];
+		int score;
+
+		if (checkMove(board, column) == fullColumn_move)
+			continue;
+
+		unsigned int cell = insertChipHashed(board, player, column, &hash);
+
+		if (checkWinner(board, player))
+			score = SEARCH_WIN_SCORE - (ply + 1);
+		else if (isBoardFull(board))
+			score = 0;
+		else
+			score = -negamax(board, (player == player1) ? player2 : player1, hash, depth - 1, ply + 1,
+							 -beta, -alpha, table, stats, NULL);
+
+		removeChipHashed(board, player, cell, &hash);
+
+		if (score > best){
+			best = score;
+			bestMove = column;
+		}
+		if (score > alpha)
+			alpha = score;
+	}
+
+	// Full board
+	if (bestMove == TT_NO_MOVE)
+		return 0;
+
+	// Aborted subtrees must not reach the table
+	if (stats->aborted)
+		return 0;
+
+	if (table != NULL){
+		tBound bound = ttExact;
+		if (best <= alphaOrig)
+			bound = ttUpper;
+		else if (best >= beta)
+			bound = ttLower;
+		ttStore(table, hash, scoreToTable(best, ply), depth, bound, bestMove, &stats->tt);
+	}
+
+	if (bestColumn != NULL)
+		*bestColumn = bestMove;
+
+	return best;
+}
+
+int searchBestMove (xsd__string board, conecta4ns__tPlayer player, int depth, tTTable *table, tSearchStats *stats, int *score){
+
+    char copy[BOARD_WIDTH * BOARD_HEIGHT];
+    int column = -1;
+
+	if (isBoardFull(board)){
+		*score = 0;
+		return -1;
+	}
+
+	// The root always searches at least one move
+	if (depth < 1)
+		depth = 1;
+
+	memcpy(copy, board, BOARD_WIDTH * BOARD_HEIGHT);
+	*score = negamax(copy, player, hashBoard(copy, player), depth, 0,
+					 -SEARCH_WIN_SCORE - 1, SEARCH_WIN_SCORE + 1, table, stats, &column);
+
+	return column;
+}
+
+int searchTimed (xsd__string board, conecta4ns__tPlayer player, int budgetMillis, tTTable *table,
+				 tSearchStats *stats, int *score, int *depth){
+
+    int empty = 0, column = -1, iterationScore;
+
+	*score = 0;
+	*depth = 0;
+
+	for (int i = 0; i < (BOARD_WIDTH * BOARD_HEIGHT); i++)
+		if (board[i] == EMPTY_CELL)
+			empty++;
+
+	clock_gettime(CLOCK_MONOTONIC, &stats->deadline);
+	stats->deadline.tv_sec += budgetMillis / 1000;
+	stats->deadline.tv_nsec += (budgetMillis % 1000) * 1000000L;
+	if (stats->deadline.tv_nsec >= 1000000000L){
+		stats->deadline.tv_sec++;
+		stats->deadline.tv_nsec -= 1000000000L;
+	}
+	stats->aborted = FALSE;
+
+	for (int d = 1; d <= empty; d++){
+
+		// The first iteration always finishes, so there is always a move
+		stats->timed = (d > 1);
+
+		int iterationColumn = searchBestMove(board, player, d, table, stats, &iterationScore);
+		if (stats->aborted)
+			break;
+
+		column = iterationColumn;
+		*score = iterationScore;
+		*depth = d;
+
+		// Solved: a deeper search cannot change the result
+		if (iterationScore > SEARCH_WIN_THRESHOLD || iterationScore < -SEARCH_WIN_THRESHOLD)
+			break;
+	}
+
+	stats->timed = FALSE;
+	return column;
+}
+
+void searchAddStats (tSearchStats *total, tSearchStats *stats){
+	total->nodes += stats->nodes;
+	ttAddStats(&total->tt, &stats->tt);
+}
\ No newline at end of file
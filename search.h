@@ -0,0 +1,67 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "ttable.h"
+#include <time.h>
+
+/** Score of a won position. Faster wins get higher scores */
+#define SEARCH_WIN_SCORE 1000
+
+/** Scores above this value are wins found by the search */
+#define SEARCH_WIN_THRESHOLD (SEARCH_WIN_SCORE - (BOARD_WIDTH * BOARD_HEIGHT))
+
+/** The clock is checked every (SEARCH_CLOCK_MASK + 1) nodes of a timed search */
+#define SEARCH_CLOCK_MASK 1023
+
+/**
+ * Counters of a search, kept by each thread
+ */
+typedef struct searchStats{
+
+	unsigned long nodes;				/** Number of visited positions */
+	tTTStats tt;						/** Counters of the transposition table */
+	int timed;							/** The search must stop at the deadline */
+	struct timespec deadline;			/** End of a timed search, in CLOCK_MONOTONIC time */
+	int aborted;						/** The deadline passed before the search finished */
+}tSearchStats;
+
+/**
+ * Searches the best move for a player with a fixed-depth alpha-beta search
+ *
+ * @param board Board of the game
+ * @param player Player that must move
+ * @param depth Number of moves to search
+ * @param table Transposition table shared with other threads, or NULL to search without it
+ * @param stats Counters of the calling thread
+ * @param score Score of the best move, from the point of view of player
+ * @return Column of the best move, or -1 if the board is full
+ */
+int searchBestMove (xsd__string board, conecta4ns__tPlayer player, int depth, tTTable *table, tSearchStats *stats, int *score);
+
+/**
+ * Searches the best move with iterative deepening until a deadline
+ *
+ * Depth 1 is always completed. The result of the deepest finished iteration is returned,
+ * and the search stops early when the position is solved.
+ *
+ * @param board Board of the game
+ * @param player Player that must move
+ * @param budgetMillis Time budget (in milliseconds)
+ * @param table Transposition table shared with other threads, or NULL to search without it
+ * @param stats Counters of the calling thread
+ * @param score Score of the best move, from the point of view of player
+ * @param depth Depth of the deepest finished iteration
+ * @return Column of the best move, or -1 if the board is full
+ */
+int searchTimed (xsd__string board, conecta4ns__tPlayer player, int budgetMillis, tTTable *table,
+				 tSearchStats *stats, int *score, int *depth);
+
+/**
+ * Adds the counters of a search to a total
+ *
+ * @param total Accumulated counters
+ * @param stats Counters to be added
+ */
+void searchAddStats (tSearchStats *total, tSearchStats *stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "soapH.h"
+#include "conecta4.nsmap"
+#include "search.h"
+#include <pthread.h>
+#include <time.h>
+
+/** Default depth of the searches */
+#define DEFAULT_DEPTH 9
+
+/** Default number of search threads */
+#define DEFAULT_THREADS 4
+
+/** Positions searched by the benchmark, as moves from the empty board */
+static const char *positions[] = {
+	"", "3", "33", "32", "34", "333", "332", "2345", "3333", "3324",
+	"4433", "3201", "334455", "323232", "3456", "1234", "3332221",
+	"33332222", "4444", "30624"
+};
+
+/** Number of positions */
+#define NUM_POSITIONS (sizeof(positions) / sizeof(positions[0]))
+
+/**
+ * Shared state of one run of the benchmark
+ */
+typedef struct benchRun{
+
+	tTTable *table;						/** Transposition table, or NULL */
+	int depth;							/** Depth of the searches */
+	int next;							/** Next position to be searched */
+	int scores[NUM_POSITIONS];			/** Score found for each position */
+	pthread_mutex_t mutex;				/** Mutex to add the counters */
+	tSearchStats total;					/** Counters of every thread */
+}tBenchRun;
+
+
+double elapsedSeconds (struct timespec *start){
+
+    struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void *searchThread (void *arg){
+
+    tBenchRun *run = (tBenchRun*) arg;
+    tSearchStats stats;
+    char board[BOARD_WIDTH * BOARD_HEIGHT];
+    int i;
+
+	memset(&stats, 0, sizeof(tSearchStats));
+
+	// Take positions until every one has been searched
+	while ((i = __sync_fetch_and_add(&run->next, 1)) < (int) NUM_POSITIONS){
+
+		conecta4ns__tPlayer player = player1;
+
+		initBoard(board);
+		playMoves(board, positions[i], &player);
+		searchBestMove(board, player, run->depth, run->table, &stats, &run->scores[i]);
+	}
+
+	pthread_mutex_lock(&run->mutex);
+	searchAddStats(&run->total, &stats);
+	pthread_mutex_unlock(&run->mutex);
+
+	return NULL;
+}
+
+double runBench (tBenchRun *run, int threads){
+
+    pthread_t tid[threads];
+    struct timespec start;
+
+	run->next = 0;
+	memset(&run->total, 0, sizeof(tSearchStats));
+	pthread_mutex_init(&run->mutex, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < threads; i++)
+		pthread_create(&tid[i], NULL, searchThread, run);
+	for (int i = 0; i < threads; i++)
+		pthread_join(tid[i], NULL);
+
+	return elapsedSeconds(&start);
+}
+
+int main(int argc, char **argv){
+
+    tBenchRun plain, cached;
+    tTTable table;
+    int depth = (argc > 1) ? atoi(argv[1]) : DEFAULT_DEPTH;
+    int threads = (argc > 2) ? atoi(argv[2]) : DEFAULT_THREADS;
+    int megabytes = (argc > 3) ? atoi(argv[3]) : TT_DEFAULT_MB;
+    int mismatches = 0;
+
+	if (depth < 1 || threads < 1 || megabytes < 1){
+		printf("Usage: %s [depth] [threads] [table MB]\n", argv[0]);
+		exit(0);
+	}
+
+	initZobrist();
+	if (!ttInit(&table, (size_t) megabytes * 1024 * 1024))
+		showError("[searchbench] Cannot allocate the transposition table");
+
+	memset(&plain, 0, sizeof(tBenchRun));
+	memset(&cached, 0, sizeof(tBenchRun));
+	plain.depth = cached.depth = depth;
+	plain.table = NULL;
+	cached.table = &table;
+
+	printf("Searching %d positions at depth %d with %d threads, table of %d MB\n",
+		   (int) NUM_POSITIONS, depth, threads, megabytes);
+
+	double plainTime = runBench(&plain, threads);
+	double cachedTime = runBench(&cached, threads);
+
+	for (int i = 0; i < (int) NUM_POSITIONS; i++)
+		if (plain.scores[i] != cached.scores[i])
+			mismatches++;
+
+	tTTStats *tt = &cached.total.tt;
+	printf("Without table: %lu nodes in %.3f s (%.0f nodes/s)\n",
+		   plain.total.nodes, plainTime, plain.total.nodes / plainTime);
+	printf("With table:    %lu nodes in %.3f s (%.0f nodes/s)\n",
+		   cached.total.nodes, cachedTime, cached.total.nodes / cachedTime);
+	printf("Table: %lu probes, %.1f%% hit rate, %.2f%% collision rate, %lu stores, %lu replaced\n",
+		   tt->probes, tt->probes ? (100.0 * tt->hits) / tt->probes : 0.0,
+		   tt->probes ? (100.0 * tt->collisions) / tt->probes : 0.0, tt->stores, tt->replaced);
+	printf("Speed-up: %.2fx (%d root scores changed by deeper transpositions)\n", plainTime / cachedTime, mismatches);
+
+	ttFree(&table);
+	return 0;
+}
\ No newline at end of file
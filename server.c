@@ -1,7 +1,16 @@
 #include "server.h"
+#include "conecta4.nsmap"
 
 /** Flag to enable debugging */
+#ifndef DEBUG_SERVER
 #define DEBUG_SERVER 1
+#endif
+
+/** Reply sent to the connections that are shed */
+#define SHED_RESPONSE "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 5\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+
+/** Reply sent to the connections of peers over their rate limit */
+#define THROTTLE_RESPONSE "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
 
 /** Array with games */
 tGame games[MAX_GAMES];
@@ -9,6 +18,60 @@ tGame games[MAX_GAMES];
 /** Mutex to protect the game status field in the array of games */
 pthread_mutex_t mutexStatusArray = PTHREAD_MUTEX_INITIALIZER;
 
+/** Number of moves performed in every game */
+unsigned int moveCount = 0;
+
+/** Number of moves rejected because it was not the turn of the player */
+unsigned long rejectedMoves = 0;
+
+/** Players waiting for a free game, in arrival order */
+tWaitingPlayer waitingQueue[ADMISSION_QUEUE_SIZE];
+
+/** Number of players in the admission queue */
+int waitingPlayers = 0;
+
+/** Mutex to protect the admission queue */
+pthread_mutex_t mutexAdmission = PTHREAD_MUTEX_INITIALIZER;
+
+/** Number of threads processing requests */
+int activeWorkers = 0;
+
+/** Number of register requests answered with ERROR_SERVER_FULL */
+unsigned long rejectedFull = 0;
+
+/** Number of free games taken by a later waiter because the head of the queue did not retry in time */
+unsigned long handedOverGames = 0;
+
+/** TRUE while a free game is kept for the head of the admission queue */
+int holdingGame = FALSE;
+
+/** End of the time a free game is kept for the head of the admission queue */
+struct timespec holdDeadline;
+
+/** Number of register requests answered with ERROR_SERVER_BUSY */
+unsigned long rejectedBusy = 0;
+
+/** Number of connections closed without being served */
+unsigned long shedConnections = 0;
+
+/** Number of getStatus responses served from the status cache */
+unsigned long statusCacheHits = 0;
+
+/** Number of getStatus responses that had to be built */
+unsigned long statusCacheMisses = 0;
+
+/** Number of getStatus responses sent from the serialized bytes of the cache */
+unsigned long responseReplays = 0;
+
+/** Number of getStatus responses serialized into the cache */
+unsigned long responseBuilds = 0;
+
+/** Parser of the HTTP headers of gSOAP, called by chargeRequest */
+int (*parseHttpHeader)(struct soap*) = NULL;
+
+/** Flag to send repeated getStatus responses from the status cache. soapbench clears it to compare them with the skeleton */
+int statusCacheEnabled = TRUE;
+
 
 void initServerStructures(){
 
@@ -18,9 +81,105 @@ void initServerStructures(){
     // Init seed
     srand(time(NULL));
 
+    // Init the keys used to hash the boards
+    initZobrist();
+
+    // Load the leaderboard of previous runs
+    initLeaderboard(LEADERBOARD_FILE);
+
+    // Read the limits of the peers and sessions
+    initRateLimits();
+
+    // Table and cache of the position analysis
+    initAnalysis();
+
     // Init each game
-    for (int i = 0; i < MAX_GAMES; i++)
-		freeGameByIndex(i);      
+    for (int i = 0; i < MAX_GAMES; i++){
+		pthread_mutex_init(&games[i].mutex, NULL);
+		pthread_cond_init(&games[i].condition, NULL);
+		pthread_mutex_init(&games[i].mutexWaiters, NULL);
+		games[i].waiters = NULL;
+		freeGameByIndex(i, loadGameState(i));
+	}
+}
+
+void futexWait(unsigned int *address, unsigned int seen, const struct timespec *timeout){
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, seen, timeout, NULL, 0);
+}
+
+void computeDeadline(int millis, struct timespec *deadline){
+
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += millis / 1000;
+	deadline->tv_nsec += (millis % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L){
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+int remainingTime(const struct timespec *deadline, struct timespec *remaining){
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	remaining->tv_sec = deadline->tv_sec - now.tv_sec;
+	remaining->tv_nsec = deadline->tv_nsec - now.tv_nsec;
+	if (remaining->tv_nsec < 0){
+		remaining->tv_sec--;
+		remaining->tv_nsec += 1000000000L;
+	}
+
+	return remaining->tv_sec >= 0;
+}
+
+void futexWake(unsigned int *address){
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+unsigned int loadGameState(int gameId){
+	return __atomic_load_n(&games[gameId].state, __ATOMIC_ACQUIRE);
+}
+
+void publishGameState(int gameId, unsigned int state){
+
+	__atomic_store_n(&games[gameId].state, state, __ATOMIC_RELEASE);
+	futexWake(&games[gameId].state);
+
+	// The list is read after the state is stored, as watchGame does in the opposite order
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&games[gameId].waiters, __ATOMIC_RELAXED) == NULL)
+		return;
+
+	pthread_mutex_lock(&games[gameId].mutexWaiters);
+	for (tWaiterLink *link = games[gameId].waiters; link != NULL; link = link->next){
+		__atomic_add_fetch(&link->waiter->changes, 1, __ATOMIC_RELEASE);
+		futexWake(&link->waiter->changes);
+	}
+	pthread_mutex_unlock(&games[gameId].mutexWaiters);
+}
+
+void watchGame(int gameId, tWaiterLink *link){
+
+	pthread_mutex_lock(&games[gameId].mutexWaiters);
+	link->next = games[gameId].waiters;
+	__atomic_store_n(&games[gameId].waiters, link, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&games[gameId].mutexWaiters);
+
+	// The state is read after the link is visible, so no published state is missed
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void unwatchGame(int gameId, tWaiterLink *link){
+
+	tWaiterLink **previous = &games[gameId].waiters;
+
+	pthread_mutex_lock(&games[gameId].mutexWaiters);
+	while (*previous != NULL && *previous != link)
+		previous = &(*previous)->next;
+	if (*previous != NULL)
+		__atomic_store_n(previous, link->next, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&games[gameId].mutexWaiters);
 }
 
 conecta4ns__tPlayer switchPlayer(conecta4ns__tPlayer currentPlayer){
@@ -39,39 +198,159 @@ int searchEmptyGame(){
 	return i;
 }
 
+int admitPlayer(xsd__string playerName, int freeGame, conecta4ns__tAdmission* admission){
+
+	time_t now = time(NULL);
+	int position = -1;
+	int i, j;
+
+	pthread_mutex_lock(&mutexAdmission);
+
+	// Remove the players that have stopped retrying
+	for (i = 0, j = 0; i < waitingPlayers; i++){
+		if ((now - waitingQueue[i].lastSeen) <= ADMISSION_EXPIRATION){
+			if (i != j)
+				waitingQueue[j] = waitingQueue[i];
+			j++;
+		}
+	}
+	waitingPlayers = j;
+
+	// Look for the player in the queue
+	for (i = 0; i < waitingPlayers && position < 0; i++){
+		if (strcmp(waitingQueue[i].name, playerName) == 0)
+			position = i;
+	}
+
+	// The hold ends when there is no free game left
+	if (!freeGame)
+		holdingGame = FALSE;
+
+	// The player takes the game if nobody arrived before
+	if (freeGame && (position == 0 || (position < 0 && waitingPlayers == 0))){
+		if (position == 0){
+			waitingPlayers--;
+			memmove(&waitingQueue[0], &waitingQueue[1], waitingPlayers * sizeof(tWaitingPlayer));
+		}
+		holdingGame = FALSE;
+		pthread_mutex_unlock(&mutexAdmission);
+		return TRUE;
+	}
+
+	// Keep the free game for the head for a while, so it does not stay idle while the head sleeps.
+	// The hold normally starts when the game is freed, or here if the queue was empty then
+	if (freeGame){
+		struct timespec remaining;
+
+		if (!holdingGame){
+			holdingGame = TRUE;
+			computeDeadline(ADMISSION_HOLD_MS, &holdDeadline);
+		}
+		else if (position > 0 && !remainingTime(&holdDeadline, &remaining)){
+			waitingPlayers--;
+			memmove(&waitingQueue[position], &waitingQueue[position + 1], (waitingPlayers - position) * sizeof(tWaitingPlayer));
+			holdingGame = FALSE;
+			pthread_mutex_unlock(&mutexAdmission);
+			__sync_fetch_and_add(&handedOverGames, 1);
+			return TRUE;
+		}
+	}
+
+	// New player, queue it only if there is room
+	if (position < 0){
+
+		if (waitingPlayers == ADMISSION_QUEUE_SIZE){
+			pthread_mutex_unlock(&mutexAdmission);
+			admission->code = ERROR_SERVER_BUSY;
+			admission->queuePosition = -1;
+			admission->retryAfter = ADMISSION_BUSY_RETRY_MS;
+			__sync_fetch_and_add(&rejectedBusy, 1);
+			return FALSE;
+		}
+
+		position = waitingPlayers++;
+		strncpy(waitingQueue[position].name, playerName, STRING_LENGTH - 1);
+		waitingQueue[position].name[STRING_LENGTH - 1] = 0;
+	}
+
+	waitingQueue[position].lastSeen = now;
+	pthread_mutex_unlock(&mutexAdmission);
+
+	admission->code = ERROR_SERVER_FULL;
+	admission->queuePosition = position + 1;
+	admission->retryAfter = ADMISSION_RETRY_MS * (position + 1);
+	if (admission->retryAfter > ADMISSION_MAX_RETRY_MS)
+		admission->retryAfter = ADMISSION_MAX_RETRY_MS;
+	__sync_fetch_and_add(&rejectedFull, 1);
+
+	return FALSE;
+}
+
+void holdFreeGame(){
+
+	pthread_mutex_lock(&mutexAdmission);
+	if (waitingPlayers > 0 && !holdingGame){
+		holdingGame = TRUE;
+		computeDeadline(ADMISSION_HOLD_MS, &holdDeadline);
+	}
+	pthread_mutex_unlock(&mutexAdmission);
+}
+
 int checkPlayer(xsd__string playerName, int gameId) {
 	return strcmp(games[gameId].player1Name, playerName) == 0;
 }
 
-void freeGameByIndex(int i){
+int freeGameByIndex(int i, unsigned int state){
 
-	// Allocate and init board
-	games[i].board = (xsd__string) malloc (BOARD_WIDTH * BOARD_HEIGHT);
-	initBoard(games[i].board);
+	// Only one thread resets the game, and the readers of the board wait until it is published
+	if (!__atomic_compare_exchange_n(&games[i].state, &state, state | STATE_BUSY_BIT, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return FALSE;
 
 	// Calculate the first player to play
-	if ((rand() % 2) == 0)
-		games[i].currentPlayer = player1;
-	else
-		games[i].currentPlayer = player2;
+	conecta4ns__tPlayer firstPlayer = ((rand() % 2) == 0) ? player1 : player2;
+
+	pthread_mutex_lock(&games[i].mutex);
+
+		// Buffers are allocated once, and reused by every game of this slot
+		if (games[i].board == NULL){
+			games[i].board = (xsd__string) malloc (BOARD_WIDTH * BOARD_HEIGHT);
+			games[i].player1Name = (xsd__string) malloc (STRING_LENGTH);
+			games[i].player2Name = (xsd__string) malloc (STRING_LENGTH);
+		}
+		else{
+			// The loser may still be waiting for the end of this game
+			games[i].lastGame.firstVersion = games[i].firstVersion;
+			games[i].lastGame.state = state;
+			memcpy(games[i].lastGame.board, games[i].board, BOARD_WIDTH * BOARD_HEIGHT);
+		}
 
-	// Allocate and init player names
-	games[i].player1Name = (xsd__string) malloc (STRING_LENGTH);
-	games[i].player2Name = (xsd__string) malloc (STRING_LENGTH);
-	memset(games[i].player1Name, 0, STRING_LENGTH);
-	memset(games[i].player2Name, 0, STRING_LENGTH);
+		// Init board and player names
+		initBoard(games[i].board);
+		memset(games[i].player1Name, 0, STRING_LENGTH);
+		memset(games[i].player2Name, 0, STRING_LENGTH);
 
-	// Game status
-	games[i].endOfGame = FALSE;
+		// Hash of the empty board
+		games[i].hash = hashBoard(games[i].board, firstPlayer);
+
+		// New version, so the cached responses of the previous game are discarded
+		games[i].statusCache[player1].valid = FALSE;
+		games[i].statusCache[player2].valid = FALSE;
+		games[i].firstVersion = stateVersion(state) + 1;
+
+	pthread_mutex_unlock(&games[i].mutex);
+
+	// The new game is published only when it is complete
+	publishGameState(i, makeState(stateVersion(state) + 1, firstPlayer, FALSE));
 
 	// Protect variable to init game
 	pthread_mutex_lock(&mutexStatusArray);
 	games[i].status = gameEmpty;
 	pthread_mutex_unlock(&mutexStatusArray);
 
-	// Init mutex and condition variable
-	pthread_mutex_init(&games[i].mutex, NULL);
-	pthread_cond_init(&games[i].condition, NULL);
+	// The head of the admission queue has the game from now
+	holdFreeGame();
+
+	return TRUE;
 }
 
 void copyGameStatusStructure(conecta4ns__tBlock* status, char* message, xsd__string board, int newCode){
@@ -95,7 +374,509 @@ void copyGameStatusStructure(conecta4ns__tBlock* status, char* message, xsd__str
     }
 }
 
-int conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, int *code){
+int lookupStatusCache(int gameId, conecta4ns__tPlayer player, conecta4ns__tBlock* status){
+
+	tStatusCacheEntry *entry = &games[gameId].statusCache[player];
+
+	// Only responses built for the current version of the game are valid
+	if (!entry->valid || entry->version != stateVersion(loadGameState(gameId))){
+		__sync_fetch_and_add(&statusCacheMisses, 1);
+		return FALSE;
+	}
+
+	status->code = entry->code;
+	memcpy((status->msgStruct).msg, entry->msg, entry->msgSize + 1);
+	(status->msgStruct).__size = entry->msgSize;
+	memcpy(status->board, entry->board, BOARD_WIDTH * BOARD_HEIGHT);
+	status->__size = BOARD_WIDTH * BOARD_HEIGHT;
+
+	__sync_fetch_and_add(&statusCacheHits, 1);
+	return TRUE;
+}
+
+void storeStatusCache(int gameId, conecta4ns__tPlayer player, conecta4ns__tBlock* status){
+
+	tStatusCacheEntry *entry = &games[gameId].statusCache[player];
+
+	entry->version = stateVersion(loadGameState(gameId));
+	entry->code = status->code;
+	entry->msgSize = (status->msgStruct).__size;
+	memcpy(entry->msg, (status->msgStruct).msg, entry->msgSize);
+	entry->msg[entry->msgSize] = 0;
+	memcpy(entry->board, status->board, BOARD_WIDTH * BOARD_HEIGHT);
+	entry->valid = TRUE;
+}
+
+/**
+ * Output function that appends the serialized envelope to the buffer of the connection
+ */
+int captureEnvelope(struct soap *soap, const char *data, size_t length){
+
+	tConnection *connection = (tConnection*) soap->user;
+
+	if (connection->responseSize < 0 || connection->responseSize + length > STATUS_RESPONSE_LENGTH){
+		connection->responseSize = -1;
+		return SOAP_OK;
+	}
+
+	memcpy(connection->response + connection->responseSize, data, length);
+	connection->responseSize += length;
+
+	return SOAP_OK;
+}
+
+int serializeStatus(struct soap *soap, conecta4ns__tBlock* status){
+
+	tConnection *connection = (tConnection*) soap->user;
+	struct conecta4ns__getStatusResponse response;
+	int (*fsend)(struct soap*, const char*, size_t) = soap->fsend;
+	SOAP_SOCKET socket = soap->socket;
+	int keepAlive = soap->keep_alive;
+	soap_mode omode = soap->omode;
+	int failed;
+
+	response.status = status;
+	connection->responseSize = 0;
+
+	// Without the socket, ending the envelope cannot shut down the connection
+	soap->fsend = captureEnvelope;
+	soap->socket = SOAP_INVALID_SOCKET;
+	soap->omode = (soap->omode & ~SOAP_IO) | SOAP_IO_BUFFER;
+
+	soap_serializeheader(soap);
+	soap_serialize_conecta4ns__getStatusResponse(soap, &response);
+	failed = soap_begin_send(soap)
+			|| soap_envelope_begin_out(soap)
+			|| soap_putheader(soap)
+			|| soap_body_begin_out(soap)
+			|| soap_put_conecta4ns__getStatusResponse(soap, &response, "conecta4ns:getStatusResponse", "")
+			|| soap_body_end_out(soap)
+			|| soap_envelope_end_out(soap)
+			|| soap_end_send(soap);
+
+	soap->fsend = fsend;
+	soap->socket = socket;
+	soap->keep_alive = keepAlive;
+	soap->omode = omode;
+	soap->error = SOAP_OK;
+
+	return !failed && connection->responseSize > 0;
+}
+
+int writeStatus(struct soap *soap, int gameId, tStatusFormat format, conecta4ns__tBlock* status){
+
+	tConnection *connection = (tConnection*) soap->user;
+
+	if (format == formatJson || format == formatBare){
+		connection->responseSize = formatHttpStatus(connection->response, STATUS_RESPONSE_LENGTH, gameId, status, format == formatBare);
+		return TRUE;
+	}
+
+	return serializeStatus(soap, status);
+}
+
+int sendStatusBytes(struct soap *soap, tStatusFormat format, const char *bytes, int size){
+
+	if (format == formatJson || format == formatBare){
+		if (sendHttpResponse(soap, format == formatBare, bytes, size))
+			return soap->error;
+		return SOAP_STOP;
+	}
+
+	// Same HTTP response as the skeleton, with the bytes of the envelope as body
+	soap->count = size;
+	if (soap_response(soap, SOAP_OK) || soap_send_raw(soap, bytes, size) || soap_end_send(soap))
+		return soap->error;
+
+	// The skeleton must not serialize the response again
+	return SOAP_STOP;
+}
+
+int replayStatus(struct soap *soap, int gameId, conecta4ns__tPlayer player, unsigned int state, tStatusFormat format, int *result){
+
+	tStatusResponse *response = &games[gameId].statusCache[player].responses[format];
+	int cached;
+
+	// The response of a version and side is always the same, so it is looked up before building anything
+	pthread_mutex_lock(&games[gameId].mutex);
+		cached = response->size > 0 && response->version == stateVersion(state);
+		if (cached)
+			response->readers++;
+	pthread_mutex_unlock(&games[gameId].mutex);
+
+	if (!cached)
+		return FALSE;
+
+	// The bytes are sent from the entry, which is not replaced while it has readers
+	*result = sendStatusBytes(soap, format, response->bytes, response->size);
+	__atomic_sub_fetch(&response->readers, 1, __ATOMIC_RELEASE);
+
+	__sync_fetch_and_add(&responseReplays, 1);
+	return TRUE;
+}
+
+void storeStatusResponse(int gameId, conecta4ns__tPlayer player, unsigned int state, tStatusFormat format, const char *bytes, int size){
+
+	tStatusResponse *response = &games[gameId].statusCache[player].responses[format];
+
+	pthread_mutex_lock(&games[gameId].mutex);
+
+		// Versions only grow, so a late request does not replace the response of a newer one
+		if (__atomic_load_n(&response->readers, __ATOMIC_ACQUIRE) == 0 &&
+			(response->size == 0 || response->version <= stateVersion(state))){
+			memcpy(response->bytes, bytes, size);
+			response->size = size;
+			response->version = stateVersion(state);
+			__sync_fetch_and_add(&responseBuilds, 1);
+		}
+
+	pthread_mutex_unlock(&games[gameId].mutex);
+}
+
+void bindStatusBlock(struct soap *soap, conecta4ns__tBlock* status){
+
+	tConnection *connection = (tConnection*) soap->user;
+
+	if (connection == NULL){
+		allocClearBlock(soap, status);
+		return;
+	}
+
+	status->code = -1;
+	(status->msgStruct).msg = connection->msg;
+	(status->msgStruct).__size = STRING_LENGTH;
+	status->__size = 0;
+	status->board = connection->board;
+}
+
+void fillTurnStatus(int gameId, conecta4ns__tPlayer player, conecta4ns__tBlock* status){
+
+	char message[STRING_LENGTH];
+
+	if (lookupStatusCache(gameId, player, status))
+		return;
+
+	// Check if it is our turn or it we have lost or is a draw
+	if(checkWinner(games[gameId].board, stateTurn(loadGameState(gameId))))
+		copyGameStatusStructure(status, "You lose!\0", games[gameId].board, GAMEOVER_LOSE);
+	else if(isBoardFull(games[gameId].board))
+		copyGameStatusStructure(status, "Draw!\0", games[gameId].board, GAMEOVER_DRAW);
+	else{
+		char playerChip = (player == player1) ? PLAYER_1_CHIP : PLAYER_2_CHIP;
+		sprintf(message, "It's your turn! Your chip is %c", playerChip);
+		copyGameStatusStructure(status, message, games[gameId].board, TURN_MOVE);
+	}
+
+	storeStatusCache(gameId, player, status);
+}
+
+/**
+ * Builds the result of a finished game for one of its players
+ */
+void fillGameResult(conecta4ns__tBlock* status, xsd__string board, unsigned int state, conecta4ns__tPlayer player){
+
+	// The turn of a finished game is the player that made the last move
+	if(!checkWinner(board, stateTurn(state)))
+		copyGameStatusStructure(status, "Draw!\0", board, GAMEOVER_DRAW);
+	else if(stateTurn(state) == player)
+		copyGameStatusStructure(status, "You win!\0", board, GAMEOVER_WIN);
+	else
+		copyGameStatusStructure(status, "You lose!\0", board, GAMEOVER_LOSE);
+}
+
+int fillFinishedStatus(struct soap *soap, int gameId, conecta4ns__tPlayer player, unsigned int state, conecta4ns__tBlock* status){
+
+	// A finished game is only busy while it is being freed, which does not change its result
+	state &= ~STATE_BUSY_BIT;
+	if(!(state & STATE_TERMINAL_BIT))
+		return FALSE;
+
+	allocClearBlock(soap, status);
+
+	pthread_mutex_lock(&games[gameId].mutex);
+
+		// The board is reset with the mutex locked, so it still belongs to this state
+		if((loadGameState(gameId) & ~STATE_BUSY_BIT) == state)
+			fillGameResult(status, games[gameId].board, state, player);
+		else if(games[gameId].lastGame.state == state)
+			fillGameResult(status, games[gameId].lastGame.board, state, player);
+		else
+			copyGameStatusStructure(status, "Player not found\0", NULL, ERROR_PLAYER_NOT_FOUND);
+
+	pthread_mutex_unlock(&games[gameId].mutex);
+
+	// The winner, or a player of a draw game, frees it, unless another request has done it
+	if(status->code == GAMEOVER_WIN || status->code == GAMEOVER_DRAW)
+		freeGameByIndex(gameId, state);
+
+	return TRUE;
+}
+
+unsigned int waitedState(int gameId, unsigned int version, unsigned int state){
+
+	// Moves do not change the game, so only a new version can come from another game
+	if(stateVersion(state) == version)
+		return state;
+
+	pthread_mutex_lock(&games[gameId].mutex);
+		if(games[gameId].lastGame.firstVersion <= version && version <= stateVersion(games[gameId].lastGame.state))
+			state = games[gameId].lastGame.state;
+	pthread_mutex_unlock(&games[gameId].mutex);
+
+	return state;
+}
+
+int findPlayer(xsd__string playerName, int gameId, conecta4ns__tPlayer *player){
+
+	if (gameId < 0 || gameId >= MAX_GAMES)
+		return FALSE;
+
+	// Free slots have empty names, so an empty name would match them
+	if (playerName == NULL || playerName[0] == 0)
+		return FALSE;
+
+	if (strcmp(games[gameId].player1Name, playerName) == 0)
+		*player = player1;
+	else if (strcmp(games[gameId].player2Name, playerName) == 0)
+		*player = player2;
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
+int playMove(xsd__string playerName, int matchID, int column){
+
+	conecta4ns__tPlayer player;
+	unsigned int state, claimed;
+	int resCode, terminal;
+
+	if (matchID < 0 || matchID >= MAX_GAMES)
+		return ERROR_WRONG_GAMEID;
+
+	if (!findPlayer(playerName, matchID, &player))
+		return ERROR_PLAYER_NOT_FOUND;
+
+	// Nobody moves until both players have registered
+	if (games[matchID].status != gameReady){
+		__sync_fetch_and_add(&rejectedMoves, 1);
+		return ERROR_NOT_YOUR_TURN;
+	}
+
+	// Claim the turn: only the player that owns it, and only one move at a time
+	state = loadGameState(matchID);
+	do{
+		if ((state & (STATE_TERMINAL_BIT | STATE_BUSY_BIT)) || stateTurn(state) != player){
+			__sync_fetch_and_add(&rejectedMoves, 1);
+			return ERROR_NOT_YOUR_TURN;
+		}
+		claimed = state | STATE_BUSY_BIT;
+	} while (!__atomic_compare_exchange_n(&games[matchID].state, &state, claimed, FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	// Full column: release the turn without changes
+	if(column < 0 || column >= BOARD_WIDTH || checkMove(games[matchID].board, column) ==  fullColumn_move){
+		publishGameState(matchID, state);
+		return TURN_REPEAT;
+	}
+
+	insertChipHashed(games[matchID].board, player, column, &games[matchID].hash);
+	terminal = TRUE;
+
+	if(checkWinner(games[matchID].board, player)){
+		resCode = GAMEOVER_WIN;
+		recordGameResult(games[matchID].player1Name, games[matchID].player2Name,
+						 (player == player1) ? resultPlayer1Wins : resultPlayer2Wins);
+		if(DEBUG_SERVER)
+			printf("%s from game %d has won the match\n", playerName, matchID);
+	}
+	else if(isBoardFull(games[matchID].board)){
+		resCode = GAMEOVER_DRAW;
+		recordGameResult(games[matchID].player1Name, games[matchID].player2Name, resultDraw);
+	}
+	else{	// Only here we change the turn -> having the winner in the turn of the state
+		player = switchPlayer(player);
+		terminal = FALSE;
+		resCode = TURN_WAIT;
+	}
+
+	// Commit the move and wake up the other player
+	publishGameState(matchID, makeState(stateVersion(state) + 1, player, terminal));
+
+	// Count the move. The batch requests of this game are woken up by publishGameState
+	__atomic_add_fetch(&moveCount, 1, __ATOMIC_RELAXED);
+
+	return resCode;
+}
+
+int readStatus(struct soap *soap, xsd__string playerName, int gameId, int waitMillis,
+			   conecta4ns__tPlayer *player, unsigned int *state, conecta4ns__tBlock* status){
+
+	struct timespec deadline, remaining;
+	unsigned int version;
+
+	if(gameId < 0 || gameId >= MAX_GAMES){
+		allocClearBlock(soap, status);
+		copyGameStatusStructure(status, "Wrong game ID\0", NULL, ERROR_WRONG_GAMEID);
+		return TRUE;
+	}
+
+	// The names are read after the state, so a game freed meanwhile is seen as a new version
+	*state = loadGameState(gameId);
+	version = stateVersion(*state);
+
+	// Unknown players get no status, and never wait in a game they do not play
+	if(!findPlayer(playerName, gameId, player)){
+		allocClearBlock(soap, status);
+		copyGameStatusStructure(status, "Player not found\0", NULL, ERROR_PLAYER_NOT_FOUND);
+		return TRUE;
+	}
+
+	// Calls over the limit are rejected before any game work
+	if(!allowSession(playerName, gameId)){
+		allocClearBlock(soap, status);
+		copyGameStatusStructure(status, "Too many requests\0", NULL, ERROR_RATE_LIMITED);
+		return TRUE;
+	}
+
+	if (DEBUG_SERVER)
+		printf("Receiving getStatus() request from -> %s in game %d\n", playerName, gameId);
+
+	// Block the player who does not move, until a new version of the game is published
+	if(DEBUG_SERVER)
+		printf("El jugador %s esta esperando...\n", playerName);
+
+	if(waitMillis >= 0)
+		computeDeadline(waitMillis, &deadline);
+
+	while(TRUE){
+
+		// The winner may have freed the game while this player was waiting, so it gets the end of its own game
+		*state = waitedState(gameId, version, *state);
+
+		if(fillFinishedStatus(soap, gameId, *player, *state, status)){
+			if(DEBUG_SERVER)
+				printf("Texto: %s\n", status->msgStruct.msg);
+			return TRUE;
+		}
+
+		if(stateTurn(*state) == *player && !(*state & STATE_BUSY_BIT))
+			break;
+
+		if(waitMillis < 0)
+			futexWait(&games[gameId].state, *state, NULL);
+		else if(remainingTime(&deadline, &remaining))
+			futexWait(&games[gameId].state, *state, &remaining);
+		else{
+			// Time is over and the other player has not moved yet: the waiting status of this version is sent
+			return FALSE;
+		}
+
+		*state = loadGameState(gameId);
+	}
+
+	if(DEBUG_SERVER)
+		printf("El jugador %s ahora esta activo!\n", playerName);
+
+	return FALSE;
+}
+
+int fillStatus(struct soap *soap, int gameId, conecta4ns__tPlayer player, unsigned int *state, conecta4ns__tBlock* status){
+
+	// A move, or the end and reset of the game, may have been published since the state was read
+	*state = waitedState(gameId, stateVersion(*state), snapshotBoard(gameId, status->board, NULL));
+
+	if(fillFinishedStatus(soap, gameId, player, *state, status))
+		return FALSE;
+
+	if(stateTurn(*state) == player){
+		status->code = TURN_MOVE;
+		sprintf((status->msgStruct).msg, "It's your turn! Your chip is %c", (player == player1) ? PLAYER_1_CHIP : PLAYER_2_CHIP);
+	}
+	else{
+		status->code = TURN_WAIT;
+		strcpy((status->msgStruct).msg, "Waiting for the other player");
+	}
+
+	(status->msgStruct).__size = strlen((status->msgStruct).msg);
+	status->__size = BOARD_WIDTH * BOARD_HEIGHT;
+
+	return TRUE;
+}
+
+int serveStatus(struct soap *soap, xsd__string playerName, int gameId, int waitMillis, tStatusFormat format, conecta4ns__tBlock* status){
+
+	tConnection *connection = (tConnection*) soap->user;
+	conecta4ns__tPlayer player;
+	unsigned int state;
+	int result;
+
+	// Errors and finished games are not cached, so they are sent by the caller
+	if(readStatus(soap, playerName, gameId, waitMillis, &player, &state, status))
+		return SOAP_OK;
+
+	// The response of this version may have been built for an earlier request
+	if(!statusCacheEnabled || connection == NULL)
+		format = formatNone;
+	if(format != formatNone && replayStatus(soap, gameId, player, state, format, &result))
+		return result;
+
+	// Memory for the response
+	bindStatusBlock(soap, status);
+	if(!fillStatus(soap, gameId, player, &state, status) || format == formatNone)
+		return SOAP_OK;
+
+	// The first request of each version builds the response, the next ones replay it
+	if(!writeStatus(soap, gameId, format, status))
+		return SOAP_OK;
+	storeStatusResponse(gameId, player, state, format, connection->response, connection->responseSize);
+
+	return sendStatusBytes(soap, format, connection->response, connection->responseSize);
+}
+
+int requestMove(xsd__string playerName, int matchID, int column){
+
+	conecta4ns__tPlayer player;
+
+	// Only players of the game have a session bucket. playMove rejects the others
+	if(findPlayer(playerName, matchID, &player) && !allowSession(playerName, matchID))
+		return ERROR_RATE_LIMITED;
+
+	return playMove(playerName, matchID, column);
+}
+
+int printServerStats(char *buffer, int length){
+
+	unsigned long hits = statusCacheHits;
+	unsigned long misses = statusCacheMisses;
+	unsigned long replays = responseReplays;
+	unsigned long builds = responseBuilds;
+	unsigned long rejected = rejectedMoves;
+	unsigned long processed, dropped;
+	unsigned long peerThrottled, sessionThrottled;
+	tAnalysisCounters analysis;
+	int players;
+	int size;
+
+	getLeaderboardCounters(&players, &processed, &dropped);
+	getRateLimitCounters(&peerThrottled, &sessionThrottled);
+	getAnalysisCounters(&analysis);
+
+	size = snprintf(buffer, length, "Status cache: %lu hits, %lu misses (%.1f%% hit rate), %lu responses replayed, %lu built\n"
+					"Admission: %d waiting, %lu full, %lu busy, %lu shed connections, %d workers, %lu handed over\n"
+					"Moves: %u committed, %lu rejected\n"
+					"Leaderboard: %d players, %lu results, %lu dropped\n"
+					"Rate limit: %lu peer connections, %lu session calls throttled\n"
+					"Analysis: %lu requests, %lu cache hits, %lu searches (%.1f ms average), %lu busy\n",
+					hits, misses, (hits + misses) ? (100.0 * hits) / (hits + misses) : 0.0, replays, builds,
+					waitingPlayers, rejectedFull, rejectedBusy, shedConnections, activeWorkers, handedOverGames,
+					moveCount, rejected, players, processed, dropped, peerThrottled, sessionThrottled,
+					analysis.requests, analysis.hits, analysis.searches,
+					analysis.searches ? analysis.searchMicros / (1000.0 * analysis.searches) : 0.0, analysis.busy);
+
+	return (size < length) ? size : length - 1;
+}
+
+int conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, conecta4ns__tAdmission* admission){
 
     int gameIndex = -1;
     int result = 0;
@@ -108,11 +889,15 @@ int conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, int
 	if(DEBUG_SERVER)
 		printf("Partida %d encontrada para el jugador %s\n", match, playerName.msg);
 
-	if(match == MAX_GAMES){
-		*code = ERROR_SERVER_FULL;
+	// Players that cannot take a game now get their queue position and a retry hint
+	if(!admitPlayer(playerName.msg, match != MAX_GAMES, admission)){
+		if(DEBUG_SERVER)
+			printf("Jugador %s en cola, posicion %d\n", playerName.msg, admission->queuePosition);
 		return SOAP_OK;
 	}
-	*code = match;
+	admission->code = match;
+	admission->queuePosition = 0;
+	admission->retryAfter = 0;
 
 	// Update game status
 	if(games[match].status == gameEmpty){	// If match is empty we register the player1
@@ -121,13 +906,13 @@ int conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, int
 		games[match].status = gameWaitingPlayer;
 		pthread_mutex_unlock(&games[match].mutex);
 
-		games[match].player1Name = malloc(sizeof(char) * playerName.__size);
-		strncpy(games[match].player1Name, playerName.msg, playerName.__size);
+		strncpy(games[match].player1Name, playerName.msg, STRING_LENGTH - 1);
 
 		if(DEBUG_SERVER)
 			printf("Durmiendo al jugador1\n");
 		pthread_mutex_lock(&games[match].mutex);
-			pthread_cond_wait(&games[match].condition, &games[match].mutex);
+			while(games[match].status != gameReady)
+				pthread_cond_wait(&games[match].condition, &games[match].mutex);
 		pthread_mutex_unlock(&games[match].mutex);
 
 		if(DEBUG_SERVER)
@@ -137,7 +922,7 @@ int conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, int
 		if(checkPlayer(playerName.msg, match)) {
 			if(DEBUG_SERVER)
 				printf("Nombres repetidos\n");
-			*code = ERROR_PLAYER_REPEATED;
+			admission->code = ERROR_PLAYER_REPEATED;
 			return SOAP_OK;
 		}
 
@@ -145,20 +930,19 @@ int conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, int
 			printf("Despertando al jugador1\n");
 
 		if(DEBUG_SERVER){
-			if(games[match].currentPlayer == player1)
+			if(stateTurn(loadGameState(match)) == player1)
 				printf("Player1 starts!\n");
 			else
 				printf("Player2 starts!\n");	
 		}
 
 		// Save new game data
-		games[match].player2Name = malloc(sizeof(char) * playerName.__size);
-		strncpy(games[match].player2Name, playerName.msg, playerName.__size);
-		pthread_cond_signal(&games[match].condition);
+		strncpy(games[match].player2Name, playerName.msg, STRING_LENGTH - 1);
 
-		// Declare the game as started
+		// Declare the game as started, and wake up player1
 		pthread_mutex_lock(&games[match].mutex);
 		games[match].status = gameReady;
+		pthread_cond_signal(&games[match].condition);
 		pthread_mutex_unlock(&games[match].mutex);
 	}
 
@@ -170,88 +954,299 @@ int conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, int
 
 int conecta4ns__getStatus(struct soap *soap, conecta4ns__tMessage playerName, int gameId, conecta4ns__tBlock* status){
 
-	char message[30];
+	// Set \0 at the end of the string
+	playerName.msg[playerName.__size] = 0;
 
-	// Alloc memory for the status
-	allocClearBlock(soap, status);
-	
-	if(checkWinner(games[gameId].board, games[gameId].currentPlayer)){
-		copyGameStatusStructure(status, "You win!\0", games[gameId].board, GAMEOVER_WIN);
-		printf("Texto: %s\n", status->msgStruct.msg);
-		freeGameByIndex(gameId);
-		return SOAP_OK;
+	// The envelope depends on the SOAP version of the request
+	tStatusFormat format = (soap->version == 1) ? formatSoap11 : (soap->version == 2) ? formatSoap12 : formatNone;
+
+	// Wait until it is the turn of the player
+	return serveStatus(soap, playerName.msg, gameId, -1, format, status);
+}
+
+int conecta4ns__insertChip(struct soap *soap, conecta4ns__tMessage playerName, int matchID, int column, int* resCode){
+
+	// Set \0 at the end of the string
+	playerName.msg[playerName.__size] = 0;
+
+	*resCode = requestMove(playerName.msg, matchID, column);
+
+	return SOAP_OK;
+}
+
+int conecta4ns__getStatusBatch(struct soap *soap, conecta4ns__tMessage playerName, conecta4ns__tGameList gameList, int waitMillis, conecta4ns__tStatusList* statusList){
+
+	int size = (gameList.__size < MAX_BATCH_SIZE) ? gameList.__size : MAX_BATCH_SIZE;
+	struct timespec deadline, remaining;
+	tBatchWaiter waiter;
+	tWaiterLink links[MAX_BATCH_SIZE];
+	char pending[MAX_BATCH_SIZE];
+	char watched[MAX_BATCH_SIZE];
+	unsigned int versions[MAX_BATCH_SIZE];
+	conecta4ns__tPlayer players[MAX_BATCH_SIZE];
+	int numPending = 0, found = FALSE;
+	unsigned int seenChanges;
+
+	// Set \0 at the end of the string
+	playerName.msg[playerName.__size] = 0;
+
+	statusList->game = (conecta4ns__tGameStatus*) soap_malloc(soap, (size + 1) * sizeof(conecta4ns__tGameStatus));
+	statusList->__size = 0;
+
+	// Games over the limit or that do not belong to the player are answered once, without cutting the wait short
+	for (int i = 0; i < size; i++){
+
+		int gameId = gameList.gameId[i];
+		int code = 0;
+
+		// The names are read after the state, so a game freed meanwhile is seen as a new version
+		if (gameId >= 0 && gameId < MAX_GAMES)
+			versions[i] = stateVersion(loadGameState(gameId));
+
+		if (!findPlayer(playerName.msg, gameId, &players[i]))
+			code = (gameId < 0 || gameId >= MAX_GAMES) ? ERROR_WRONG_GAMEID : ERROR_PLAYER_NOT_FOUND;
+		else if (!allowSession(playerName.msg, gameId))
+			code = ERROR_RATE_LIMITED;
+
+		pending[i] = (code == 0);
+		if (pending[i]){
+			numPending++;
+			continue;
+		}
+
+		conecta4ns__tGameStatus *game = &statusList->game[statusList->__size++];
+		game->gameId = gameId;
+		allocClearBlock(soap, &game->status);
+		copyGameStatusStructure(&game->status, (code == ERROR_RATE_LIMITED) ? "Too many requests\0" : "Player not found\0",
+								NULL, code);
 	}
-	else if(isBoardFull(games[gameId].board)){
-		copyGameStatusStructure(status, "Draw!\0", games[gameId].board, GAMEOVER_DRAW);
-		freeGameByIndex(gameId);
-		return SOAP_OK;
+
+	if (waitMillis > MAX_BATCH_WAIT_MS)
+		waitMillis = MAX_BATCH_WAIT_MS;
+	computeDeadline(waitMillis, &deadline);
+
+	// Sleep on a word of this request, woken up only by the moves of its games
+	waiter.changes = 0;
+	for (int i = 0; i < size; i++){
+		watched[i] = pending[i] && waitMillis > 0;
+		if (watched[i]){
+			links[i].waiter = &waiter;
+			watchGame(gameList.gameId[i], &links[i]);
+		}
 	}
 
+	while (numPending > 0){
 
-	if (DEBUG_SERVER)
-		printf("Receiving getStatus() request from -> %s in game %d\n", playerName.msg, gameId);
+		// States published after this scan wake up the request
+		seenChanges = __atomic_load_n(&waiter.changes, __ATOMIC_ACQUIRE);
 
-	// Select the current player
-	conecta4ns__tPlayer player = checkPlayer(playerName.msg, gameId) ? player1 : player2;
-	char playerChip = (player == player1) ? PLAYER_1_CHIP : PLAYER_2_CHIP;
-	sprintf(&message, "It's your turn! Your chip is %c", playerChip);
+		for (int i = 0; i < size; i++){
 
-	// Block the player who does not move
-	pthread_mutex_lock(&games[gameId].mutex);
+			int gameId = gameList.gameId[i];
+			conecta4ns__tGameStatus *game = &statusList->game[statusList->__size];
+			unsigned int state;
 
-		if(DEBUG_SERVER)
-			printf("El jugador %s esta esperando...\n", playerName.msg);
+			if (!pending[i])
+				continue;
 
-		while(!games[gameId].endOfGame && games[gameId].currentPlayer != player){
-			pthread_cond_wait(&games[gameId].condition, &games[gameId].mutex);
+			game->gameId = gameId;
+
+			// The winner may have freed the game while waiting, so the player gets the end of its own game
+			state = waitedState(gameId, versions[i], loadGameState(gameId));
+
+			// Only a terminal state has a result to build
+			if (state & STATE_TERMINAL_BIT){
+				fillFinishedStatus(soap, gameId, players[i], state, &game->status);
+				statusList->__size++;
+				pending[i] = FALSE;
+				numPending--;
+				found = TRUE;
+				continue;
+			}
+
+			// The game has been freed and taken by other players, and its result is no longer kept
+			if (stateVersion(state) != versions[i]){
+				allocClearBlock(soap, &game->status);
+				copyGameStatusStructure(&game->status, "Player not found\0", NULL, ERROR_PLAYER_NOT_FOUND);
+				statusList->__size++;
+				pending[i] = FALSE;
+				numPending--;
+				continue;
+			}
+
+			// Only the games where it is the turn of the player are returned
+			if (stateTurn(state) == players[i] && !(state & STATE_BUSY_BIT)){
+				allocClearBlock(soap, &game->status);
+				pthread_mutex_lock(&games[gameId].mutex);
+				fillTurnStatus(gameId, players[i], &game->status);
+				pthread_mutex_unlock(&games[gameId].mutex);
+				statusList->__size++;
+				found = TRUE;
+			}
 		}
 
-		if(DEBUG_SERVER)
-			printf("El jugador %s ahora esta activo!\n", playerName.msg);
+		if (found || waitMillis <= 0 || !remainingTime(&deadline, &remaining))
+			break;
 
-		// Check if it is our turn or it we have lost or is a draw
-		if(checkWinner(games[gameId].board, games[gameId].currentPlayer))
-			copyGameStatusStructure(status, "You lose!\0", games[gameId].board, GAMEOVER_LOSE);
-		else if(isBoardFull(games[gameId].board))
-			copyGameStatusStructure(status, "Draw!\0", games[gameId].board, GAMEOVER_DRAW);
-		else
-			copyGameStatusStructure(status, &message, games[gameId].board, TURN_MOVE);
-	pthread_mutex_unlock(&games[gameId].mutex);
+		futexWait(&waiter.changes, seenChanges, &remaining);
+	}
+
+	for (int i = 0; i < size; i++)
+		if (watched[i])
+			unwatchGame(gameList.gameId[i], &links[i]);
 
 	return SOAP_OK;
 }
 
-int conecta4ns__insertChip(struct soap *soap, conecta4ns__tMessage playerName, int matchID, int column, int* resCode){
+int conecta4ns__insertChipBatch(struct soap *soap, conecta4ns__tMessage playerName, conecta4ns__tMoveList moveList, conecta4ns__tResultList* resultList){
 
-	if(checkMove(games[matchID].board, column) ==  fullColumn_move){
-		*resCode = TURN_REPEAT;
-		return SOAP_OK;
-	}
+	int size = (moveList.__size < MAX_BATCH_SIZE) ? moveList.__size : MAX_BATCH_SIZE;
 
-	conecta4ns__tPlayer player = checkPlayer(playerName.msg, matchID) ? player1 : player2;
-	insertChip(games[matchID].board, player, column);
-	
-	if(checkWinner(games[matchID].board, games[matchID].currentPlayer)){
-		*resCode = GAMEOVER_WIN;
-		games[matchID].endOfGame = TRUE;
-		if(DEBUG_SERVER)
-			printf("%s from game %d has won the match\n", playerName.msg, matchID);
+	// Set \0 at the end of the string
+	playerName.msg[playerName.__size] = 0;
+
+	resultList->result = (conecta4ns__tMoveResult*) soap_malloc(soap, (size + 1) * sizeof(conecta4ns__tMoveResult));
+	resultList->__size = size;
+
+	for (int i = 0; i < size; i++){
+
+		conecta4ns__tMoveRequest *move = &moveList.move[i];
+
+		resultList->result[i].gameId = move->gameId;
+
+		// Moves over the limit, of unknown players or out of turn are rejected with the codes of insertChip,
+		// so ERROR_NOT_YOUR_TURN tells a rejected move from one that has been performed (TURN_WAIT)
+		resultList->result[i].resCode = requestMove(playerName.msg, move->gameId, move->column);
 	}
-	else{
-		if(isBoardFull(games[matchID].board)){
-			*resCode = GAMEOVER_DRAW;
-			games[matchID].endOfGame = TRUE;
+
+	return SOAP_OK;
+}
+
+int conecta4ns__getServerStats(struct soap *soap, conecta4ns__tMessage* stats){
+
+	stats->msg = (xsd__string) soap_malloc(soap, STATS_LENGTH);
+	stats->__size = printServerStats(stats->msg, STATS_LENGTH);
+
+	return SOAP_OK;
+}
+
+void copyPlayerStats(struct soap *soap, conecta4ns__tPlayerStats *to, tPlayerScore *from){
+	to->name = soap_strdup(soap, from->name);
+	to->wins = from->wins;
+	to->draws = from->draws;
+	to->losses = from->losses;
+	to->rating = from->rating;
+}
+
+int conecta4ns__getLeaderboard(struct soap *soap, conecta4ns__tMessage playerName, int topK, conecta4ns__tLeaderboard* leaderboard){
+
+	tPlayerScore top[LEADERBOARD_MAX_TOP];
+	tPlayerScore caller;
+	int numTop;
+
+	// Set \0 at the end of the string
+	playerName.msg[playerName.__size] = 0;
+
+	if (topK > LEADERBOARD_MAX_TOP)
+		topK = LEADERBOARD_MAX_TOP;
+
+	leaderboard->rank = queryLeaderboard(playerName.msg, topK, top, &numTop, &caller);
+	copyPlayerStats(soap, &leaderboard->caller, &caller);
+
+	leaderboard->player = (conecta4ns__tPlayerStats*) soap_malloc(soap, (numTop + 1) * sizeof(conecta4ns__tPlayerStats));
+	leaderboard->__size = numTop;
+	for (int i = 0; i < numTop; i++)
+		copyPlayerStats(soap, &leaderboard->player[i], &top[i]);
+
+	return SOAP_OK;
+}
+
+unsigned int snapshotBoard(int gameId, xsd__string board, tHash *hash){
+
+	unsigned int state, check;
+
+	state = loadGameState(gameId);
+	while(TRUE){
+
+		// Wait for the move in progress to be published
+		if(state & STATE_BUSY_BIT){
+			futexWait(&games[gameId].state, state, NULL);
+			state = loadGameState(gameId);
+			continue;
 		}
-		else{	// Only here we change the turn -> having the winner in the currentPlayer
-			games[matchID].currentPlayer = switchPlayer(player);
-			*resCode = TURN_WAIT;
+
+		memcpy(board, games[gameId].board, BOARD_WIDTH * BOARD_HEIGHT);
+		if(hash != NULL)
+			*hash = games[gameId].hash;
+
+		// The copy must be read before the state is checked again
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		check = loadGameState(gameId);
+		if(check == state)
+			return state;
+
+		state = check;
+	}
+}
+
+int fillFinishedAnalysis(xsd__string board, conecta4ns__tAnalysis* analysis){
+
+	analysis->column = -1;
+	analysis->score = 0;
+	analysis->depth = 0;
+
+	if(checkWinner(board, player1) || checkWinner(board, player2)){
+		analysis->code = GAMEOVER_WIN;
+		analysis->player = checkWinner(board, player1) ? player1 : player2;
+		return TRUE;
+	}
+
+	if(isBoardFull(board)){
+		analysis->code = GAMEOVER_DRAW;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+int conecta4ns__analyzePosition(struct soap *soap, int gameId, conecta4ns__tMessage board, int budgetMillis, conecta4ns__tAnalysis* analysis){
+
+	char position[BOARD_WIDTH * BOARD_HEIGHT];
+	conecta4ns__tPlayer player;
+	tHash hash;
+
+	memset(analysis, 0, sizeof(conecta4ns__tAnalysis));
+	analysis->column = -1;
+
+	if(budgetMillis <= 0)
+		budgetMillis = ANALYSIS_DEFAULT_BUDGET_MS;
+	else if(budgetMillis > ANALYSIS_MAX_BUDGET_MS)
+		budgetMillis = ANALYSIS_MAX_BUDGET_MS;
+
+	// A game of the server, or a board sent by the caller
+	if(gameId >= 0){
+		if(gameId >= MAX_GAMES || games[gameId].status == gameEmpty){
+			analysis->code = ERROR_WRONG_GAMEID;
+			return SOAP_OK;
 		}
+		// The hash kept by the moves of the game belongs to the copied board
+		player = stateTurn(snapshotBoard(gameId, position, &hash));
+	}
+	else if(!readBoard(board.msg, board.__size, position, &player)){
+		analysis->code = ERROR_INVALID_BOARD;
+		return SOAP_OK;
 	}
+	else
+		hash = hashBoard(position, player);
 
-	// Wake up the other player
-	pthread_mutex_lock(&games[matchID].mutex);
-		pthread_cond_signal(&games[matchID].condition);
-	pthread_mutex_unlock(&games[matchID].mutex);
+	analysis->player = player;
+	if(fillFinishedAnalysis(position, analysis))
+		return SOAP_OK;
+
+	if(DEBUG_SERVER)
+		printf("Analizando posicion (partida %d) con %d ms\n", gameId, budgetMillis);
+
+	analyzeBoard(position, player, hash, budgetMillis, analysis);
 
 	return SOAP_OK;
 }
@@ -267,22 +1262,97 @@ void *processRequest(void *soap){
 	soap_destroy((struct soap*)soap);
 	soap_end((struct soap*)soap);
 	soap_done((struct soap*)soap);
+	free(((struct soap*)soap)->user);
 	free(soap);
 
+	__sync_fetch_and_sub(&activeWorkers, 1);
+
 	return NULL;
 }
 
-int main(int argc, char **argv){ 
+int chargeRequest(struct soap *soap){
+
+	tConnection *connection = (tConnection*) soap->user;
+
+	// Keep-alive requests take a token each, as the ones that open a connection
+	if (connection->requests++ > 0 && !connection->local && !allowPeer(soap->ip)){
+		send(soap->socket, THROTTLE_RESPONSE, strlen(THROTTLE_RESPONSE), MSG_NOSIGNAL);
+		soap->keep_alive = 0;
+		return SOAP_STOP;
+	}
+
+	return parseHttpHeader(soap);
+}
+
+int dispatchConnection(struct soap *soap, SOAP_SOCKET s, int local){
 
-	struct soap soap;
 	struct soap *tsoap;
 	pthread_t tid;
+
+	// Reject the connection before spawning a thread if the peer is over its limit.
+	// Local frontends share one address, so only their sessions are limited.
+	// This is the token of the first request, chargeRequest takes the next ones
+	if (!local && !allowPeer(soap->ip)){
+		send(s, THROTTLE_RESPONSE, strlen(THROTTLE_RESPONSE), MSG_NOSIGNAL);
+		close(s);
+		soap->socket = SOAP_INVALID_SOCKET;
+		return TRUE;
+	}
+
+	// Shed the connection if there are too many requests in progress
+	if (activeWorkers >= MAX_WORKERS){
+		send(s, SHED_RESPONSE, strlen(SHED_RESPONSE), MSG_NOSIGNAL);
+		close(s);
+		soap->socket = SOAP_INVALID_SOCKET;
+		__sync_fetch_and_add(&shedConnections, 1);
+		return TRUE;
+	}
+
+	// Copy the SOAP environment
+	tsoap = soap_copy(soap);
+
+	if (!tsoap){
+		printf ("SOAP copy error!\n");
+		return FALSE;
+	}
+
+	// Buffers for the responses served from the status cache
+	tsoap->user = calloc(1, sizeof(tConnection));
+	((tConnection*) tsoap->user)->local = local;
+
+	// Create a new thread to process the request
+	__sync_fetch_and_add(&activeWorkers, 1);
+	pthread_create(&tid, NULL, (void*(*)(void*))processRequest, (void*)tsoap);
+
+	return TRUE;
+}
+
+#ifndef SERVER_NO_MAIN
+int main(int argc, char **argv){ 
+
+	struct soap soap;
+	struct pollfd listeners[2];
+	int numListeners = 1;
 	int port;
-	SOAP_SOCKET m, s;
+	char *unixPath = NULL;
+	SOAP_SOCKET m, u, s;
+
+	// Check arguments
+	if (argc < 2 || argc > 3){
+		printf("Usage: %s port [unix socket path]\n", argv[0]);
+		exit(0);
+	}
 
 	// Init soap environment
 	soap_init(&soap);
 
+	// Browsers and mobile frontends can use plain HTTP/JSON for status and moves
+	useHttpFastPath(&soap);
+
+	// Every request of a keep-alive connection is charged to its peer
+	parseHttpHeader = soap.fparse;
+	soap.fparse = chargeRequest;
+
 	// Configure timeouts
 	soap.send_timeout = 60; // 60 seconds
 	soap.recv_timeout = 60; // 60 seconds
@@ -302,37 +1372,96 @@ int main(int argc, char **argv){
 		exit(1);
 	}
 
+	listeners[0].fd = m;
+	listeners[0].events = POLLIN;
+
+	// Co-located clients can also connect through a Unix domain socket
+	if (argc == 3){
+		unixPath = argv[2];
+		u = bindUnixSocket(unixPath, 100);
+
+		if (!soap_valid_socket(u)){
+			perror("Unix socket");
+			exit(1);
+		}
+
+		listeners[1].fd = u;
+		listeners[1].events = POLLIN;
+		numListeners = 2;
+	}
+
+	tRateLimit peerLimit, sessionLimit;
+	getRateLimits(&peerLimit, &sessionLimit);
+	printf("Rate limits: %.0f/s (burst %.0f) per peer, %.0f/s (burst %.0f) per session (0 = no limit)\n",
+		   peerLimit.perSecond, peerLimit.burst, sessionLimit.perSecond, sessionLimit.burst);
+
 	printf("Server is ON ...\n");
 	while (TRUE){
 
-		// Accept a new connection
-		s = soap_accept(&soap);
+		// Wait for a new connection in any listener
+		int ready = poll(listeners, numListeners, soap.accept_timeout * 1000);
 
-		// Socket is not valid :(
-		if (!soap_valid_socket(s)){
+		if (ready < 0 && errno == EINTR)
+			continue;
 
-			if (soap.errnum){
-				soap_print_fault(&soap, stderr);
-				exit(1);
-			}
+		if (ready < 0){
+			perror("poll");
+			break;
+		}
 
+		if (ready == 0){
 			fprintf(stderr, "Time out!\n");
 			break;
 		}
 
-		// Copy the SOAP environment
-		tsoap = soap_copy(&soap);
+		if (listeners[0].revents & POLLIN){
 
-		if (!tsoap){
-			printf ("SOAP copy error!\n");
-			break;
+			// Accept a new connection
+			s = soap_accept(&soap);
+
+			// Socket is not valid :(
+			if (!soap_valid_socket(s)){
+
+				if (soap.errnum){
+					soap_print_fault(&soap, stderr);
+					exit(1);
+				}
+
+				fprintf(stderr, "Time out!\n");
+				break;
+			}
+
+			if (!dispatchConnection(&soap, s, FALSE))
+				break;
 		}
 
-		// Create a new thread to process the request
-		pthread_create(&tid, NULL, (void*(*)(void*))processRequest, (void*)tsoap);
+		if (numListeners == 2 && (listeners[1].revents & POLLIN)){
+
+			// Accept a new local connection, served as any other one
+			s = accept(u, NULL, NULL);
+
+			if (soap_valid_socket(s)){
+				soap.socket = s;
+				soap.ip = RATE_LOCAL_PEER;
+				if (!dispatchConnection(&soap, s, TRUE))
+					break;
+			}
+		}
 	}
 
+	// Show the statistics of this session
+	char stats[STATS_LENGTH];
+	printServerStats(stats, STATS_LENGTH);
+	printf("%s", stats);
+
+	if (unixPath != NULL)
+		unlink(unixPath);
+
+	// Save the last results
+	stopLeaderboard();
+
 	// Detach SOAP environment
 	soap_done(&soap);
 	return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
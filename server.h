@@ -1,29 +1,179 @@
 #include "soapH.h"
-#include "conecta4.nsmap"
 #include "game.h"
+#include "zobrist.h"
+#include "transport.h"
+#include "leaderboard.h"
+#include "ratelimit.h"
+#include "httpapi.h"
+#include "analysis.h"
 #include <pthread.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 /** Maximum number of active games in the server */
-#define MAX_GAMES 5
+#define MAX_GAMES 256
+
+/** Maximum number of games in a batch request */
+#define MAX_BATCH_SIZE 256
+
+/** Maximum time a getStatusBatch request waits for a game (in milliseconds) */
+#define MAX_BATCH_WAIT_MS 30000
+
+/** Maximum number of players waiting for a free game */
+#define ADMISSION_QUEUE_SIZE 32
+
+/** Seconds without retrying before a waiting player loses its position */
+#define ADMISSION_EXPIRATION 15
+
+/** Retry hint for each position in the admission queue (in milliseconds) */
+#define ADMISSION_RETRY_MS 500
+
+/** Largest retry hint of the admission queue. With the jitter of the clients it stays below ADMISSION_EXPIRATION */
+#define ADMISSION_MAX_RETRY_MS (ADMISSION_EXPIRATION * 1000 / 2)
+
+/** Time a free game is kept for the head of the admission queue before the next waiter takes it (in milliseconds) */
+#define ADMISSION_HOLD_MS 1000
+
+/** Retry hint when the server is overloaded (in milliseconds) */
+#define ADMISSION_BUSY_RETRY_MS 5000
+
+/** Maximum number of threads processing requests. New connections are shed above this */
+#define MAX_WORKERS (4 * MAX_GAMES)
+
+/** Maximum length of a serialized getStatus response kept in the status cache */
+#define STATUS_RESPONSE_LENGTH 2048
+
+/** Maximum length of the server statistics report */
+#define STATS_LENGTH 1024
+
+/** Bit of the game state word with the player that must move */
+#define STATE_TURN_BIT 0x1
+
+/** Bit of the game state word set when the game has finished */
+#define STATE_TERMINAL_BIT 0x2
+
+/** Bit of the game state word set while a move is being performed */
+#define STATE_BUSY_BIT 0x4
+
+/** Position of the version in the game state word */
+#define STATE_VERSION_SHIFT 3
+
+/** Player that must move */
+#define stateTurn(state) ((conecta4ns__tPlayer) ((state) & STATE_TURN_BIT))
+
+/** Version of the game: incremented by every move and every new game */
+#define stateVersion(state) ((state) >> STATE_VERSION_SHIFT)
+
+/** Builds a game state word */
+#define makeState(version, turn, terminal) \
+	(((version) << STATE_VERSION_SHIFT) | ((turn) == player2 ? STATE_TURN_BIT : 0) | ((terminal) ? STATE_TERMINAL_BIT : 0))
 
 /** Type for game status */
 typedef enum { gameEmpty, gameWaitingPlayer, gameReady } tGameState;
 
+/**
+ * Player waiting in the admission queue for a free game
+ */
+typedef struct waitingPlayer{
+
+	char name[STRING_LENGTH];			/** Name of the player */
+	time_t lastSeen;					/** Time of the last register request of the player */
+}tWaitingPlayer;
+
+/** Formats of the getStatus responses kept in the status cache */
+typedef enum { formatNone = -1, formatSoap11, formatSoap12, formatJson, formatBare, NUM_STATUS_FORMATS } tStatusFormat;
+
+/**
+ * Serialized getStatus response in one format, sent again without being built
+ */
+typedef struct statusResponse{
+
+	unsigned int version;				/** Game version the bytes were built for */
+	int size;							/** Length of the bytes, or 0 if no response has been built */
+	int readers;						/** Requests sending the bytes now. The bytes are only replaced when it is 0 */
+	char bytes[STATUS_RESPONSE_LENGTH];	/** Body of the response: SOAP envelope, JSON or bare text */
+}tStatusResponse;
+
+/**
+ * Cached getStatus response for one side of a game
+ */
+typedef struct statusCacheEntry{
+
+	unsigned int version;				/** Game version this response was built for */
+	int valid;							/** Flag to indicate that the entry holds a response */
+	int code;							/** Code sent to the player */
+	int msgSize;						/** Length of the message */
+	char msg[STRING_LENGTH];			/** Message sent to the player */
+	char board[BOARD_WIDTH * BOARD_HEIGHT];	/** Board sent to the player */
+	tStatusResponse responses[NUM_STATUS_FORMATS];	/** Serialized responses of each format */
+}tStatusCacheEntry;
+
+/**
+ * Per-connection buffers, reused by every request of a keep-alive sequence
+ */
+typedef struct connection{
+
+	int local;							/** TRUE if the connection comes from the Unix domain socket */
+	unsigned int requests;				/** Requests received by the connection */
+	char msg[STRING_LENGTH];			/** Storage for the message of the block */
+	char board[BOARD_WIDTH * BOARD_HEIGHT];	/** Storage for the board of the block */
+	int responseSize;					/** Bytes of the response being serialized, or -1 if it does not fit */
+	char response[STATUS_RESPONSE_LENGTH];	/** Storage for the response sent to the player */
+}tConnection;
+
+/**
+ * getStatusBatch request waiting for a turn in any of its games
+ */
+typedef struct batchWaiter{
+
+	unsigned int changes;				/** Incremented each time one of its games publishes a new state */
+}tBatchWaiter;
+
+/**
+ * Entry of a batch request in the list of waiters of one game
+ */
+typedef struct waiterLink{
+
+	tBatchWaiter *waiter;				/** Waiting request */
+	struct waiterLink *next;			/** Next waiter of the same game */
+}tWaiterLink;
+
+/**
+ * Last state of a game that has been freed, kept for the players that were waiting for it
+ */
+typedef struct finishedGame{
+
+	unsigned int firstVersion;			/** Version of the game when it was created */
+	unsigned int state;					/** Terminal state word of the game, or 0 if no game has been freed */
+	char board[BOARD_WIDTH * BOARD_HEIGHT];	/** Final board of the game */
+}tFinishedGame;
+
 /**
  * Struct that contains a game for 2 players
  */
 typedef struct game{
 
 	xsd__string board;					/** Board of the game */
-	conecta4ns__tPlayer currentPlayer;	/** Current player */
+	tHash hash;							/** Zobrist hash of the board and the player to move */
 	xsd__string player1Name;			/** Name of player 1 */
 	xsd__string player2Name;			/** Name of player 2 */
-	int endOfGame;						/** Flag to control the end of the game*/
 	tGameState status;					/** Flag to indicate the status of this game */
-	pthread_mutex_t mutex;				/** Mutex for condition variable */
-	pthread_cond_t condition;			/** Condition variable to make players turn */
+	unsigned int state;					/** Turn, terminal flag and version, changed only with atomic operations */
+	unsigned int firstVersion;			/** Version of the game when it was created */
+	tFinishedGame lastGame;				/** Previous game of this slot, protected by the mutex */
+	tStatusCacheEntry statusCache[2];	/** Last getStatus responses sent to each player */
+	pthread_mutex_t mutex;				/** Mutex for condition variable and status cache */
+	pthread_cond_t condition;			/** Condition variable to wait for the second player */
+	tWaiterLink *waiters;				/** Batch requests waiting for this game */
+	pthread_mutex_t mutexWaiters;		/** Mutex for the list of waiters */
 }tGame;
 
 
@@ -32,6 +182,74 @@ typedef struct game{
  */
 void initServerStructures ();
 
+/**
+ * Waits until a 32-bit word changes
+ *
+ * @param address Word to wait for
+ * @param seen Last value read from the word. Returns at once if the word has another value
+ * @param timeout Maximum time to wait, or NULL to wait forever
+ */
+void futexWait (unsigned int *address, unsigned int seen, const struct timespec *timeout);
+
+/**
+ * Computes the time when a wait must end
+ *
+ * @param millis Maximum time to wait (in milliseconds)
+ * @param deadline Where the end of the wait is stored, in CLOCK_MONOTONIC time
+ */
+void computeDeadline (int millis, struct timespec *deadline);
+
+/**
+ * Computes the time left until a deadline
+ *
+ * @param deadline End of the wait
+ * @param remaining Where the time left is stored
+ * @return TRUE if the deadline has not passed yet, or FALSE in another case
+ */
+int remainingTime (const struct timespec *deadline, struct timespec *remaining);
+
+/**
+ * Wakes up every thread waiting for a 32-bit word
+ *
+ * @param address Word that has changed
+ */
+void futexWake (unsigned int *address);
+
+/**
+ * Reads the state word of a game
+ *
+ * @param gameId ID of the game
+ * @return State word
+ */
+unsigned int loadGameState (int gameId);
+
+/**
+ * Publishes a new state word of a game and wakes up the threads waiting for it
+ *
+ * @param gameId ID of the game
+ * @param state New state word
+ */
+void publishGameState (int gameId, unsigned int state);
+
+/**
+ * Adds a batch request to the waiters of a game
+ *
+ * Every state published after this call increments the changes of the waiter and wakes it up,
+ * so a batch request sleeps on its own word and only the moves of its games wake it up.
+ *
+ * @param gameId ID of the game
+ * @param link Entry of the request in the list, valid until unwatchGame
+ */
+void watchGame (int gameId, tWaiterLink *link);
+
+/**
+ * Removes a batch request from the waiters of a game
+ *
+ * @param gameId ID of the game
+ * @param link Entry given to watchGame
+ */
+void unwatchGame (int gameId, tWaiterLink *link);
+
 /**
  * Gets the other player
  *
@@ -48,6 +266,29 @@ conecta4ns__tPlayer switchPlayer (conecta4ns__tPlayer currentPlayer);
  */
 int searchEmptyGame ();
 
+/**
+ * Decides if a player can take a free game or must wait in the admission queue.
+ *
+ * Players are admitted in arrival order: while the queue is not empty, a free game is
+ * kept for the player at its head. If the head does not retry within ADMISSION_HOLD_MS
+ * since the game was freed, the next waiter that retries takes the game, and the head keeps its position.
+ * Players that stop retrying for ADMISSION_EXPIRATION seconds are removed from the queue.
+ *
+ * @param playerName Name of the player
+ * @param freeGame TRUE if searchEmptyGame has found a game for the player
+ * @param admission Structure where the queue position and retry hint are stored
+ * @return TRUE if the player can take the free game, or FALSE in another case.
+ */
+int admitPlayer (xsd__string playerName, int freeGame, conecta4ns__tAdmission* admission);
+
+/**
+ * Starts to keep a free game for the head of the admission queue, if there are players waiting
+ *
+ * Called when a game is freed, so the time of the head counts from then and not from the
+ * next register request.
+ */
+void holdFreeGame ();
+
 /**
  * Checks if a player is already registered in the game with ID=gameId
  *
@@ -60,9 +301,16 @@ int checkPlayer (xsd__string playerName, int gameId);
 
 /**
  * Initializes the game structure at the index position in the array
+ *
+ * The game is marked as busy before the board and names are reset, and the new state is
+ * published at the end, so readers never see it half initialized. The final state and board
+ * are kept in lastGame.
+ *
  * @param i Position of the game in the array
+ * @param state State word the game must still have (its terminal state, or the initial one at startup)
+ * @return TRUE if the game has been reset, or FALSE if another thread has changed it before
  */
-void freeGameByIndex (int i);
+int freeGameByIndex (int i, unsigned int state);
 
 /**
  * Copies the data to be sent in a conecta4ns__tBlock structure.
@@ -74,6 +322,294 @@ void freeGameByIndex (int i);
  */
 void copyGameStatusStructure (conecta4ns__tBlock* status, char* message, xsd__string board, int newCode);
 
+/**
+ * Copies a getStatus response from the cache of the game.
+ *
+ * Must be called with the mutex of the game locked.
+ *
+ * @param gameId ID of the game.
+ * @param player Player that requests the status.
+ * @param status Structure, with memory for the message and board, where the response is copied.
+ * @return TRUE if the response was found in the cache, or FALSE in another case.
+ */
+int lookupStatusCache (int gameId, conecta4ns__tPlayer player, conecta4ns__tBlock* status);
+
+/**
+ * Stores a getStatus response in the cache of the game.
+ *
+ * Must be called with the mutex of the game locked.
+ *
+ * @param gameId ID of the game.
+ * @param player Player that requests the status.
+ * @param status Response to be cached.
+ */
+void storeStatusCache (int gameId, conecta4ns__tPlayer player, conecta4ns__tBlock* status);
+
+/**
+ * Serializes a getStatus response into the response buffer of the connection.
+ *
+ * Writes the same envelope as the generated skeleton, through an output function that
+ * fills the buffer instead of the socket. The envelope depends on the SOAP version of the
+ * request, so each version has its own entry in the status cache.
+ *
+ * @param soap Soap context of the request, with a tConnection in soap->user.
+ * @param status Response to be serialized.
+ * @return TRUE if the envelope fits in the buffer, or FALSE in another case.
+ */
+int serializeStatus (struct soap *soap, conecta4ns__tBlock* status);
+
+/**
+ * Writes a getStatus response in the response buffer of the connection.
+ *
+ * @param soap Soap context of the request, with a tConnection in soap->user.
+ * @param gameId ID of the game.
+ * @param format Format of the response.
+ * @param status Response to be written.
+ * @return TRUE if the response fits in the buffer, or FALSE in another case.
+ */
+int writeStatus (struct soap *soap, int gameId, tStatusFormat format, conecta4ns__tBlock* status);
+
+/**
+ * Sends the body of a getStatus response, with the same HTTP header the skeleton or the
+ * HTTP/JSON fast path would send.
+ *
+ * @param soap Soap context of the request.
+ * @param format Format of the response.
+ * @param bytes Body of the response.
+ * @param size Length of the body.
+ * @return SOAP_STOP if the response has been sent, or an error code of gSOAP.
+ */
+int sendStatusBytes (struct soap *soap, tStatusFormat format, const char *bytes, int size);
+
+/**
+ * Sends a getStatus response from the status cache, if it has been built for this version of the game.
+ *
+ * The bytes are sent from the cache entry, which is not replaced while it is being sent.
+ *
+ * @param soap Soap context of the request.
+ * @param gameId ID of the game.
+ * @param player Player that requests the status.
+ * @param state State word the response is for.
+ * @param format Format of the response.
+ * @param result Where the result of sendStatusBytes is stored.
+ * @return TRUE if the response was found in the cache, or FALSE in another case.
+ */
+int replayStatus (struct soap *soap, int gameId, conecta4ns__tPlayer player, unsigned int state, tStatusFormat format, int *result);
+
+/**
+ * Stores a serialized getStatus response in the status cache.
+ *
+ * @param gameId ID of the game.
+ * @param player Player that requests the status.
+ * @param state State word the response was built for.
+ * @param format Format of the response.
+ * @param bytes Body of the response.
+ * @param size Length of the body.
+ */
+void storeStatusResponse (int gameId, conecta4ns__tPlayer player, unsigned int state, tStatusFormat format, const char *bytes, int size);
+
+/**
+ * Gives memory to a conecta4ns__tBlock structure.
+ *
+ * The buffers of the connection are used when available, so no memory is allocated.
+ *
+ * @param soap Soap context of the request.
+ * @param status Structure where the code, message and board will be stored.
+ */
+void bindStatusBlock (struct soap *soap, conecta4ns__tBlock* status);
+
+/**
+ * Builds the response for a player that has got the turn, or whose game has finished
+ * while waiting. Repeated polls on the same version of the game are served from the cache.
+ * Used by getStatusBatch.
+ *
+ * Must be called with the mutex of the game locked.
+ *
+ * @param gameId ID of the game.
+ * @param player Player that requests the status.
+ * @param status Structure, with memory for the message and board, where the response is built.
+ */
+void fillTurnStatus (int gameId, conecta4ns__tPlayer player, conecta4ns__tBlock* status);
+
+/**
+ * Builds the response for a player whose game has already finished.
+ *
+ * The game is freed when the winner, or a player of a draw game, gets the response.
+ * If it has been freed already, the response is built from its last state.
+ *
+ * @param soap Soap context of the request.
+ * @param gameId ID of the game.
+ * @param player Player that requests the status.
+ * @param state State word of the game read by the caller.
+ * @param status Structure where the response is built.
+ * @return TRUE if the game has finished, or FALSE in another case.
+ */
+int fillFinishedStatus (struct soap *soap, int gameId, conecta4ns__tPlayer player, unsigned int state, conecta4ns__tBlock* status);
+
+/**
+ * Gets the state a waiting player must be answered with
+ *
+ * @param gameId ID of the game.
+ * @param version Version of the game when the player started waiting.
+ * @param state Current state word of the game.
+ * @return The last state of the game of the player if it has been freed meanwhile, or state in another case.
+ */
+unsigned int waitedState (int gameId, unsigned int version, unsigned int state);
+
+/**
+ * Gets the side of a player in a game
+ *
+ * @param playerName Name of the player
+ * @param gameId ID of the game
+ * @param player Where the side of the player is stored
+ * @return TRUE if the player is registered in the game, or FALSE in another case (also for empty names).
+ */
+int findPlayer (xsd__string playerName, int gameId, conecta4ns__tPlayer *player);
+
+/**
+ * Performs a move of a player
+ *
+ * The turn is claimed with a compare-and-swap on the state word of the game, so only
+ * the player that owns the turn can move, and duplicated or concurrent moves are rejected
+ * without taking any lock. Games that have not started yet reject every move.
+ *
+ * @param playerName Name of the player
+ * @param matchID ID of the game
+ * @param column Column to insert the chip
+ * @return Result code of the move
+ */
+int playMove (xsd__string playerName, int matchID, int column);
+
+/**
+ * Waits until a player can be answered with the status of a game
+ *
+ * Shared by the SOAP service and the HTTP/JSON fast path. Calls over the rate limit of the
+ * session are answered with ERROR_RATE_LIMITED before any game work, and names that are not
+ * registered in the game with ERROR_PLAYER_NOT_FOUND. A player whose game finishes and is
+ * freed while waiting gets the result of that game.
+ *
+ * @param soap Soap context of the request
+ * @param playerName Name of the player
+ * @param gameId ID of the game
+ * @param waitMillis Maximum time to wait for the turn (in milliseconds), or -1 to wait without limit.
+ *                   When the time is over the player gets the status with TURN_WAIT
+ * @param player Where the side of the player is stored
+ * @param state Where the state word the player must be answered for is stored
+ * @param status Structure where the response is built, for errors and finished games
+ * @return TRUE if the response is in status, or FALSE if the player gets the turn or waiting status of state
+ */
+int readStatus (struct soap *soap, xsd__string playerName, int gameId, int waitMillis,
+				conecta4ns__tPlayer *player, unsigned int *state, conecta4ns__tBlock* status);
+
+/**
+ * Builds the turn or waiting status of a game for a player
+ *
+ * The board is copied without the mutex of the game, so the state is updated if a move has
+ * been published since readStatus.
+ *
+ * @param soap Soap context of the request
+ * @param gameId ID of the game
+ * @param player Player that requests the status
+ * @param state State word the status is for. Updated with the state of the copied board
+ * @param status Structure, with memory for the message and board, where the response is built
+ * @return TRUE if the response can be cached, or FALSE if the game has finished
+ */
+int fillStatus (struct soap *soap, int gameId, conecta4ns__tPlayer player, unsigned int *state, conecta4ns__tBlock* status);
+
+/**
+ * Answers a getStatus request, from the status cache when the response has been built before
+ *
+ * The cache is looked up with the version of the game, the side of the player and the
+ * format, before any response is built. Only errors and finished games are left to the caller.
+ *
+ * @param soap Soap context of the request
+ * @param playerName Name of the player
+ * @param gameId ID of the game
+ * @param waitMillis Maximum time to wait for the turn (in milliseconds), or -1 to wait without limit
+ * @param format Format of the response, or formatNone to build it without the cache
+ * @param status Structure where the response is built when it is not sent
+ * @return SOAP_STOP if the response has been sent, SOAP_OK if the caller must send status,
+ *         or an error code of gSOAP.
+ */
+int serveStatus (struct soap *soap, xsd__string playerName, int gameId, int waitMillis, tStatusFormat format, conecta4ns__tBlock* status);
+
+/**
+ * Performs a move of a player, if the session is not over its rate limit
+ *
+ * Shared by the SOAP service and the HTTP/JSON fast path.
+ *
+ * @param playerName Name of the player
+ * @param matchID ID of the game
+ * @param column Column to insert the chip
+ * @return Result code of the move, or ERROR_RATE_LIMITED
+ */
+int requestMove (xsd__string playerName, int matchID, int column);
+
+/**
+ * Copies the statistics of a player of the leaderboard to a response.
+ *
+ * @param soap Soap context of the request.
+ * @param to Structure of the response.
+ * @param from Statistics of the player.
+ */
+void copyPlayerStats (struct soap *soap, conecta4ns__tPlayerStats *to, tPlayerScore *from);
+
+/**
+ * Copies the board of a game without taking its mutex
+ *
+ * The copy is repeated until no move has been performed or started while copying, so
+ * it is always a board that has been published.
+ *
+ * @param gameId ID of the game
+ * @param board Where the board is copied
+ * @param hash Where the hash of the board is copied, or NULL
+ * @return State word of the game the board belongs to
+ */
+unsigned int snapshotBoard (int gameId, xsd__string board, tHash *hash);
+
+/**
+ * Fills the analysis of a finished position: the winner and GAMEOVER_WIN, or GAMEOVER_DRAW
+ *
+ * @param board Board of the position
+ * @param analysis Structure where the result is stored
+ * @return TRUE if the position is finished, or FALSE in another case
+ */
+int fillFinishedAnalysis (xsd__string board, conecta4ns__tAnalysis* analysis);
+
+/**
+ * Writes the server statistics in a buffer.
+ *
+ * @param buffer Buffer where the report is written.
+ * @param length Size of the buffer.
+ * @return Length of the report.
+ */
+int printServerStats (char *buffer, int length);
+
+/**
+ * Charges a request to the rate limit of its peer, and parses its HTTP header. Installed as soap->fparse
+ *
+ * The first request of a connection is charged by dispatchConnection, and each of the next
+ * ones of a keep-alive sequence here. Peers over their limit get an HTTP 429 and the connection
+ * is closed.
+ *
+ * @param soap Soap context of the request, with a tConnection in soap->user
+ * @return Result of the parser of gSOAP, or SOAP_STOP if the request has been rejected
+ */
+int chargeRequest (struct soap *soap);
+
+/**
+ * Creates a thread to process the requests of a new connection
+ *
+ * The connection is closed without being served if there are too many requests in progress,
+ * or if a TCP peer is over its rate limit.
+ *
+ * @param soap Soap context of the server, with the accepted socket
+ * @param s Accepted socket
+ * @param local TRUE if the connection comes from the Unix domain socket
+ * @return TRUE if the connection has been handled, or FALSE if the soap context cannot be copied
+ */
+int dispatchConnection (struct soap *soap, SOAP_SOCKET s, int local);
+
 /**
  * Thread function to process client requests
  */
@@ -0,0 +1,723 @@
+#define _GNU_SOURCE
+#include "server.h"
+#include <fcntl.h>
+
+/** Default number of games to play */
+#define DEFAULT_GAMES 1000
+
+/** Initial size of the in-memory buffers */
+#define BUFFER_SIZE 65536
+
+/** Operations measured by the benchmark */
+typedef enum { opRegister, opGetStatus, opRepeatStatus, opInsertChip, opHttpStatus, opHttpMove, NUM_OPS } tOperation;
+
+/** Names of the operations */
+static const char *opNames[NUM_OPS] = { "register", "getStatus", "getStatus2", "insertChip", "GET status", "POST move" };
+
+/**
+ * Growable buffer that replaces a socket
+ */
+typedef struct memBuffer{
+
+	char *data;							/** Bytes written */
+	size_t length;						/** Number of bytes written */
+	size_t position;					/** Next byte to be read */
+	size_t capacity;					/** Size of data */
+}tMemBuffer;
+
+/**
+ * Client and server joined by memory. The client sends the request to the server buffer,
+ * and the first read of the client runs soap_serve on it.
+ */
+typedef struct loopback{
+
+	struct soap client;					/** Context of the client */
+	struct soap server;					/** Context of the server */
+	tMemBuffer request;					/** Bytes sent by the client */
+	tMemBuffer response;				/** Bytes sent by the server */
+	int served;							/** The request of the current call was served */
+	int http;							/** The current call uses the HTTP/JSON fast path */
+	double serveStart;					/** Time when soap_serve started */
+	double serveEnd;					/** Time when soap_serve returned */
+	double handlerStart;				/** Time when the handler started */
+	double handlerEnd;					/** Time when the handler returned */
+	double sendStart;					/** Time of the first write of the response, or 0 */
+	size_t serverAllocs;				/** Allocations done by soap_serve */
+}tLoopback;
+
+/**
+ * Totals of one operation
+ */
+typedef struct opStats{
+
+	unsigned long calls;				/** Number of measured calls */
+	double total;						/** Time of the whole call (ns) */
+	double cpu;							/** CPU time of the whole call (ns) */
+	double encode;						/** Client builds and sends the request (ns) */
+	double parse;						/** Server reads and decodes the request (ns) */
+	double handler;						/** Game logic (ns) */
+	double serialize;					/** Server encodes and sends the response (ns) */
+	double decode;						/** Client reads and decodes the response (ns) */
+	unsigned long allocs;				/** Allocations of the whole call */
+	unsigned long serverAllocs;			/** Allocations done by the server */
+	unsigned long allocBytes;			/** Bytes requested to the allocator */
+	unsigned long requestBytes;			/** Bytes of the requests */
+	unsigned long responseBytes;		/** Bytes of the responses */
+}tOpStats;
+
+/** Games of the server (server.c) */
+extern tGame games[MAX_GAMES];
+
+/** Flag of the server (server.c) to send repeated getStatus responses from the status cache */
+extern int statusCacheEnabled;
+
+/** Compare every getStatus response of the status cache with the one written without it */
+static int checkResponses = FALSE;
+
+/** Loopback used by the current thread */
+static __thread tLoopback *currentLoop = NULL;
+
+/** Only the calls of the measuring thread are counted */
+static __thread int countAllocs = FALSE;
+static __thread size_t allocCount = 0;
+static __thread size_t allocBytes = 0;
+
+/** Descriptor given to the contexts instead of a socket */
+static int nullSocket = -1;
+
+/** Statistics of each operation */
+static tOpStats opStats[NUM_OPS];
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+
+double nowNanoseconds (){
+
+    struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+double cpuNanoseconds (){
+
+    struct timespec now;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/**
+ * Allocator interposed on libc and libgsoap, counting the calls of the measuring thread
+ */
+void *malloc (size_t size){
+
+	if (countAllocs){
+		allocCount++;
+		allocBytes += size;
+	}
+
+	return __libc_malloc(size);
+}
+
+void *calloc (size_t count, size_t size){
+
+	if (countAllocs){
+		allocCount++;
+		allocBytes += count * size;
+	}
+
+	return __libc_calloc(count, size);
+}
+
+void *realloc (void *ptr, size_t size){
+
+	if (countAllocs){
+		allocCount++;
+		allocBytes += size;
+	}
+
+	return __libc_realloc(ptr, size);
+}
+
+void free (void *ptr){
+	__libc_free(ptr);
+}
+
+/**
+ * Handlers wrapped by the linker (-Wl,--wrap), so the time spent in the game logic is
+ * separated from the time spent by soap_serve decoding and encoding
+ */
+int __real_conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, conecta4ns__tAdmission* admission);
+int __real_conecta4ns__getStatus(struct soap *soap, conecta4ns__tMessage playerName, int gameId, conecta4ns__tBlock* status);
+int __real_conecta4ns__insertChip(struct soap *soap, conecta4ns__tMessage playerName, int matchID, int column, int* resCode);
+int __real_serveStatus(struct soap *soap, xsd__string playerName, int gameId, int waitMillis, tStatusFormat format, conecta4ns__tBlock* status);
+int __real_requestMove(xsd__string playerName, int matchID, int column);
+
+int __wrap_conecta4ns__register(struct soap *soap, conecta4ns__tMessage playerName, conecta4ns__tAdmission* admission){
+
+	currentLoop->handlerStart = nowNanoseconds();
+	int result = __real_conecta4ns__register(soap, playerName, admission);
+	currentLoop->handlerEnd = nowNanoseconds();
+
+	return result;
+}
+
+int __wrap_conecta4ns__getStatus(struct soap *soap, conecta4ns__tMessage playerName, int gameId, conecta4ns__tBlock* status){
+
+	currentLoop->handlerStart = nowNanoseconds();
+	int result = __real_conecta4ns__getStatus(soap, playerName, gameId, status);
+	currentLoop->handlerEnd = nowNanoseconds();
+
+	return result;
+}
+
+int __wrap_conecta4ns__insertChip(struct soap *soap, conecta4ns__tMessage playerName, int matchID, int column, int* resCode){
+
+	currentLoop->handlerStart = nowNanoseconds();
+	int result = __real_conecta4ns__insertChip(soap, playerName, matchID, column, resCode);
+	currentLoop->handlerEnd = nowNanoseconds();
+
+	return result;
+}
+
+/**
+ * Game logic shared with the HTTP/JSON fast path. Only its calls from httpapi.c are wrapped
+ */
+int __wrap_serveStatus(struct soap *soap, xsd__string playerName, int gameId, int waitMillis, tStatusFormat format, conecta4ns__tBlock* status){
+
+	if (currentLoop->http)
+		currentLoop->handlerStart = nowNanoseconds();
+	int result = __real_serveStatus(soap, playerName, gameId, waitMillis, format, status);
+	if (currentLoop->http)
+		currentLoop->handlerEnd = nowNanoseconds();
+
+	return result;
+}
+
+int __wrap_requestMove(xsd__string playerName, int matchID, int column){
+
+	if (currentLoop->http)
+		currentLoop->handlerStart = nowNanoseconds();
+	int result = __real_requestMove(playerName, matchID, column);
+	if (currentLoop->http)
+		currentLoop->handlerEnd = nowNanoseconds();
+
+	return result;
+}
+
+void appendBuffer (tMemBuffer *buffer, const char *data, size_t length){
+
+	if (buffer->length + length > buffer->capacity){
+		while (buffer->length + length > buffer->capacity)
+			buffer->capacity = buffer->capacity ? buffer->capacity * 2 : BUFFER_SIZE;
+		buffer->data = (char*) realloc(buffer->data, buffer->capacity);
+	}
+
+	memcpy(buffer->data + buffer->length, data, length);
+	buffer->length += length;
+}
+
+size_t readBuffer (tMemBuffer *buffer, char *data, size_t length){
+
+	size_t available = buffer->length - buffer->position;
+
+	if (length > available)
+		length = available;
+
+	memcpy(data, buffer->data + buffer->position, length);
+	buffer->position += length;
+
+	return length;
+}
+
+/**
+ * I/O callbacks of the server: the request is read from memory and the response is written to memory
+ */
+size_t serverRecv (struct soap *soap, char *data, size_t length){
+	return readBuffer(&currentLoop->request, data, length);
+}
+
+int serverSend (struct soap *soap, const char *data, size_t length){
+
+	if (currentLoop->sendStart == 0)
+		currentLoop->sendStart = nowNanoseconds();
+
+	appendBuffer(&currentLoop->response, data, length);
+	return SOAP_OK;
+}
+
+/**
+ * I/O callbacks of the client. The first read after a request runs the server on it.
+ */
+void resetExchange (tLoopback *loop){
+
+	loop->request.length = loop->request.position = 0;
+	loop->response.length = loop->response.position = 0;
+	loop->served = FALSE;
+	loop->sendStart = 0;
+}
+
+SOAP_SOCKET clientOpen (struct soap *soap, const char *endpoint, const char *host, int port){
+
+	resetExchange(currentLoop);
+	return nullSocket;
+}
+
+int clientClose (struct soap *soap){
+	return SOAP_OK;
+}
+
+int clientSend (struct soap *soap, const char *data, size_t length){
+
+	// A new request on a kept-alive context
+	if (currentLoop->served)
+		resetExchange(currentLoop);
+
+	appendBuffer(&currentLoop->request, data, length);
+	return SOAP_OK;
+}
+
+/**
+ * Runs soap_serve on the request written to the loopback
+ */
+void serveRequest (tLoopback *loop){
+
+    size_t allocsBefore = allocCount;
+
+	loop->served = TRUE;
+	loop->server.socket = nullSocket;
+	loop->serveStart = nowNanoseconds();
+	soap_serve(&loop->server);
+	loop->serveEnd = nowNanoseconds();
+	soap_destroy(&loop->server);
+	soap_end(&loop->server);
+	loop->serverAllocs = allocCount - allocsBefore;
+}
+
+size_t clientRecv (struct soap *soap, char *data, size_t length){
+
+	if (!currentLoop->served)
+		serveRequest(currentLoop);
+
+	return readBuffer(&currentLoop->response, data, length);
+}
+
+void initLoopback (tLoopback *loop){
+
+	memset(loop, 0, sizeof(tLoopback));
+
+	soap_init(&loop->client);
+	loop->client.fopen = clientOpen;
+	loop->client.fclose = clientClose;
+	loop->client.fsend = clientSend;
+	loop->client.frecv = clientRecv;
+
+	soap_init(&loop->server);
+	loop->server.socket = nullSocket;
+	loop->server.fclose = clientClose;
+	loop->server.fsend = serverSend;
+	loop->server.frecv = serverRecv;
+	loop->server.user = calloc(1, sizeof(tConnection));
+	useHttpFastPath(&loop->server);
+
+	currentLoop = loop;
+}
+
+void doneLoopback (tLoopback *loop){
+
+	free(loop->server.user);
+	loop->server.user = NULL;
+	soap_done(&loop->server);
+	soap_done(&loop->client);
+	free(loop->request.data);
+	free(loop->response.data);
+}
+
+/**
+ * Starts the measure of one call on the current thread
+ */
+void beginMeasure (){
+
+	allocCount = 0;
+	allocBytes = 0;
+	countAllocs = TRUE;
+}
+
+/**
+ * Adds the measure of the last call on the current thread to the statistics of an operation
+ */
+void endMeasure (tOperation op, double start, double cpuStart){
+
+    double end = nowNanoseconds();
+    double cpuEnd = cpuNanoseconds();
+    tLoopback *loop = currentLoop;
+    tOpStats *stats = &opStats[op];
+    double handlerEnd = loop->handlerEnd;
+
+	countAllocs = FALSE;
+
+	// Responses replayed from the status cache are written by the handler, and that write is serialization
+	if (loop->sendStart > loop->handlerStart && loop->sendStart < handlerEnd)
+		handlerEnd = loop->sendStart;
+
+	stats->calls++;
+	stats->total += end - start;
+	stats->cpu += cpuEnd - cpuStart;
+	stats->encode += loop->serveStart - start;
+	stats->parse += loop->handlerStart - loop->serveStart;
+	stats->handler += handlerEnd - loop->handlerStart;
+	stats->serialize += loop->serveEnd - handlerEnd;
+	stats->decode += end - loop->serveEnd;
+	stats->allocs += allocCount;
+	stats->serverAllocs += loop->serverAllocs;
+	stats->allocBytes += allocBytes;
+	stats->requestBytes += loop->request.length;
+	stats->responseBytes += loop->response.length;
+}
+
+/**
+ * Registers the first player of a game, which is blocked until the second player arrives
+ */
+void *registerFirstPlayer (void *arg){
+
+    tLoopback loop;
+    conecta4ns__tMessage playerName;
+    conecta4ns__tAdmission admission;
+    int *match = (int*) arg;
+
+	initLoopback(&loop);
+	playerName.msg = "bench-player1";
+	playerName.__size = strlen(playerName.msg);
+
+	if (soap_call_conecta4ns__register(&loop.client, "http://localhost", "", playerName, &admission) != SOAP_OK)
+		admission.code = ERROR_SERVER_BUSY;
+	*match = admission.code;
+
+	soap_end(&loop.client);
+	doneLoopback(&loop);
+
+	return NULL;
+}
+
+/**
+ * Waits until the first player is sleeping in a game
+ */
+void waitFirstPlayer (){
+
+	for (;;){
+		for (int i = 0; i < MAX_GAMES; i++)
+			if (__atomic_load_n(&games[i].status, __ATOMIC_ACQUIRE) == gameWaitingPlayer)
+				return;
+		usleep(50);
+	}
+}
+
+int measureGetStatus (tLoopback *loop, tOperation op, conecta4ns__tMessage playerName, int match, char *board){
+
+    conecta4ns__tBlock status;
+    double start, cpuStart;
+
+	beginMeasure();
+	start = nowNanoseconds();
+	cpuStart = cpuNanoseconds();
+	if (soap_call_conecta4ns__getStatus(&loop->client, "http://localhost", "", playerName, match, &status) != SOAP_OK){
+		countAllocs = FALSE;
+		soap_print_fault(&loop->client, stderr);
+		exit(1);
+	}
+	endMeasure(op, start, cpuStart);
+
+	if (board != NULL && status.board != NULL)
+		memcpy(board, status.board, BOARD_WIDTH * BOARD_HEIGHT);
+
+	soap_end(&loop->client);
+	return status.code;
+}
+
+int measureInsertChip (tLoopback *loop, conecta4ns__tMessage playerName, int match, int column){
+
+    int resCode = TURN_REPEAT;
+    double start, cpuStart;
+
+	beginMeasure();
+	start = nowNanoseconds();
+	cpuStart = cpuNanoseconds();
+	if (soap_call_conecta4ns__insertChip(&loop->client, "http://localhost", "", playerName, match, column, &resCode) != SOAP_OK){
+		countAllocs = FALSE;
+		soap_print_fault(&loop->client, stderr);
+		exit(1);
+	}
+	endMeasure(opInsertChip, start, cpuStart);
+
+	soap_end(&loop->client);
+	return resCode;
+}
+
+/**
+ * Reads a number after a key of the JSON response, and optionally the board
+ */
+int parseJsonResponse (tMemBuffer *response, char *board){
+
+    char body[HTTP_RESPONSE_LENGTH + 1];
+    char *start, *field;
+    size_t length;
+
+	start = memmem(response->data, response->length, "\r\n\r\n", 4);
+	if (start == NULL)
+		return ERROR_PLAYER_NOT_FOUND;
+
+	start += 4;
+	length = response->length - (start - response->data);
+	if (length > HTTP_RESPONSE_LENGTH)
+		length = HTTP_RESPONSE_LENGTH;
+	memcpy(body, start, length);
+	body[length] = 0;
+
+	if (board != NULL && (field = strstr(body, "\"board\":\"")) != NULL)
+		memcpy(board, field + 9, BOARD_WIDTH * BOARD_HEIGHT);
+
+	field = strstr(body, "\"code\":");
+	return (field != NULL) ? atoi(field + 7) : ERROR_PLAYER_NOT_FOUND;
+}
+
+/**
+ * Sends a raw HTTP request through the loopback, as a browser would, and decodes the JSON response.
+ * The measure starts before the request is built, so building it counts as encoding.
+ */
+int httpExchange (tLoopback *loop, tOperation op, const char *request, int length, char *board, double start, double cpuStart){
+
+	loop->http = TRUE;
+	resetExchange(loop);
+	appendBuffer(&loop->request, request, length);
+	serveRequest(loop);
+	int code = parseJsonResponse(&loop->response, board);
+	loop->http = FALSE;
+
+	endMeasure(op, start, cpuStart);
+	return code;
+}
+
+int measureHttpStatus (tLoopback *loop, conecta4ns__tMessage playerName, int match, char *board){
+
+    char request[HTTP_RESPONSE_LENGTH];
+    int length;
+
+	beginMeasure();
+	double start = nowNanoseconds();
+	double cpuStart = cpuNanoseconds();
+
+	length = snprintf(request, sizeof(request), "GET " HTTP_STATUS_PATH "?game=%d&player=%s&wait=0 HTTP/1.1\r\n"
+					  "Host: localhost\r\n\r\n", match, playerName.msg);
+
+	return httpExchange(loop, opHttpStatus, request, length, board, start, cpuStart);
+}
+
+int measureHttpMove (tLoopback *loop, conecta4ns__tMessage playerName, int match, int column){
+
+    char form[HTTP_FORM_LENGTH];
+    char request[HTTP_RESPONSE_LENGTH + HTTP_FORM_LENGTH];
+    int length;
+
+	beginMeasure();
+	double start = nowNanoseconds();
+	double cpuStart = cpuNanoseconds();
+
+	length = snprintf(form, sizeof(form), "game=%d&player=%s&column=%d", match, playerName.msg, column);
+	length = snprintf(request, sizeof(request), "POST " HTTP_MOVE_PATH " HTTP/1.1\r\nHost: localhost\r\n"
+					  "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %d\r\n\r\n%s", length, form);
+
+	return httpExchange(loop, opHttpMove, request, length, NULL, start, cpuStart);
+}
+
+/**
+ * Reads the status of the player to move without the status cache, and then building and
+ * replaying it from the cache. The three responses must have the same bytes, or the benchmark stops.
+ */
+void checkStatus (tLoopback *loop, conecta4ns__tMessage playerName, int match, char *board, int http){
+
+    static tMemBuffer expected;
+    const char *stage[2] = { "built", "replayed" };
+
+	statusCacheEnabled = FALSE;
+	if (http)
+		measureHttpStatus(loop, playerName, match, board);
+	else
+		measureGetStatus(loop, opGetStatus, playerName, match, board);
+	statusCacheEnabled = TRUE;
+
+	expected.length = 0;
+	appendBuffer(&expected, loop->response.data, loop->response.length);
+
+	for (int i = 0; i < 2; i++){
+
+		if (http)
+			measureHttpStatus(loop, playerName, match, NULL);
+		else
+			measureGetStatus(loop, opRepeatStatus, playerName, match, NULL);
+
+		if (loop->response.length != expected.length || memcmp(loop->response.data, expected.data, expected.length) != 0){
+			fprintf(stderr, "The %s response differs from the one written without the cache\n"
+					"--- without cache\n%.*s\n--- %s\n%.*s\n", stage[i], (int) expected.length, expected.data,
+					stage[i], (int) loop->response.length, loop->response.data);
+			exit(1);
+		}
+	}
+}
+
+/**
+ * Plays one game through the loopback. Only the register of the second player is measured,
+ * because the first one is blocked until the second arrives.
+ *
+ * Status and moves use the SOAP service, or the HTTP/JSON fast path if http is TRUE.
+ */
+void playGame (tLoopback *loop, unsigned int *seed, int http){
+
+    conecta4ns__tMessage names[2];
+    conecta4ns__tAdmission admission;
+    char board[BOARD_WIDTH * BOARD_HEIGHT];
+    pthread_t firstPlayer;
+    int match;
+    double start, cpuStart;
+
+	names[player1].msg = "bench-player1";
+	names[player2].msg = "bench-player2";
+	names[player1].__size = strlen(names[player1].msg);
+	names[player2].__size = strlen(names[player2].msg);
+
+	pthread_create(&firstPlayer, NULL, registerFirstPlayer, &match);
+	waitFirstPlayer();
+
+	beginMeasure();
+	start = nowNanoseconds();
+	cpuStart = cpuNanoseconds();
+	if (soap_call_conecta4ns__register(&loop->client, "http://localhost", "", names[player2], &admission) != SOAP_OK){
+		countAllocs = FALSE;
+		soap_print_fault(&loop->client, stderr);
+		exit(1);
+	}
+	endMeasure(opRegister, start, cpuStart);
+	soap_end(&loop->client);
+
+	pthread_join(firstPlayer, NULL);
+
+	if (match < 0 || admission.code != match){
+		fprintf(stderr, "Register failed: %d %d\n", match, admission.code);
+		exit(1);
+	}
+
+	unsigned int state = loadGameState(match);
+
+	while (!(state & STATE_TERMINAL_BIT)){
+
+		conecta4ns__tPlayer turn = stateTurn(state);
+		int column;
+
+		if (checkResponses)
+			checkStatus(loop, names[turn], match, board, http);
+		else if (http)
+			measureHttpStatus(loop, names[turn], match, board);
+		else{
+			measureGetStatus(loop, opGetStatus, names[turn], match, board);
+
+			// A second read of the same version replays the serialized envelope
+			measureGetStatus(loop, opRepeatStatus, names[turn], match, NULL);
+		}
+
+		do{
+			column = rand_r(seed) % BOARD_WIDTH;
+		} while (getDropCell(board, column) == BOARD_WIDTH * BOARD_HEIGHT);
+
+		if (http)
+			measureHttpMove(loop, names[turn], match, column);
+		else
+			measureInsertChip(loop, names[turn], match, column);
+		state = loadGameState(match);
+	}
+
+	// The loser reads the result first, because the winner frees the game
+	unsigned int version = stateVersion(state);
+	for (int i = 0; i < 2 && stateVersion(loadGameState(match)) == version; i++){
+
+		conecta4ns__tPlayer player = (i == 0) ? switchPlayer(stateTurn(state)) : stateTurn(state);
+
+		if (http)
+			measureHttpStatus(loop, names[player], match, NULL);
+		else
+			measureGetStatus(loop, opGetStatus, names[player], match, NULL);
+	}
+}
+
+void printOpStats (){
+
+	printf("%-11s %9s %9s %9s %8s %8s %8s %9s %8s %8s %8s %9s %8s %8s\n",
+			"operation", "calls", "ns/op", "cpu-ns/op", "encode", "parse", "handler", "serialize", "decode",
+			"allocs", "srv-alc", "alc-bytes", "req-B", "resp-B");
+
+	for (int op = 0; op < NUM_OPS; op++){
+
+		tOpStats *s = &opStats[op];
+		double n = s->calls ? (double) s->calls : 1.0;
+
+		printf("%-11s %9lu %9.0f %9.0f %8.0f %8.0f %8.0f %9.0f %8.0f %8.1f %8.1f %9.0f %8.0f %8.0f\n",
+				opNames[op], s->calls, s->total / n, s->cpu / n, s->encode / n, s->parse / n, s->handler / n,
+				s->serialize / n, s->decode / n, s->allocs / n, s->serverAllocs / n,
+				s->allocBytes / n, s->requestBytes / n, s->responseBytes / n);
+	}
+}
+
+int main (int argc, char **argv){
+
+    tLoopback loop;
+    int numGames = DEFAULT_GAMES;
+    unsigned int seed = 12345;
+
+	if (argc > 1)
+		numGames = atoi(argv[1]);
+
+	// Check mode: the responses of the status cache are compared with the skeleton
+	if (argc > 2)
+		checkResponses = (strcmp(argv[2], "check") == 0);
+
+	if (numGames <= 0 || argc > 3 || (argc > 2 && !checkResponses)){
+		printf("Usage: %s [games] [check]\n", argv[0]);
+		exit(0);
+	}
+
+	// The contexts need a descriptor, although it is never read or written
+	nullSocket = open("/dev/null", O_RDWR);
+	if (nullSocket < 0){
+		perror("/dev/null");
+		exit(1);
+	}
+
+	// Rate limits are checked on every call, but never reached
+	setenv(RATE_PEER_PER_SECOND_ENV, "1e12", FALSE);
+	setenv(RATE_SESSION_PER_SECOND_ENV, "1e12", FALSE);
+	setenv(RATE_SESSION_BURST_ENV, "1e12", FALSE);
+
+	initServerStructures();
+	initLoopback(&loop);
+
+	double start = nowNanoseconds();
+	// Even games use the SOAP service and odd games the HTTP/JSON fast path
+	for (int game = 0; game < numGames; game++)
+		playGame(&loop, &seed, game % 2);
+	double elapsed = nowNanoseconds() - start;
+
+	printf("%d games in %.3f s, no sockets (ns per call; allocs and bytes per call)\n", numGames, elapsed / 1e9);
+	printf("Half of the games play through SOAP (getStatus, insertChip) and half through HTTP/JSON (GET status, POST move)\n");
+	printOpStats();
+
+	if (checkResponses)
+		printf("Every response of the status cache had the same bytes as the one written without it\n");
+
+	doneLoopback(&loop);
+	stopLeaderboard();
+	close(nullSocket);
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "transport.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/**
+ * Replaces tcp_connect in the client contexts that use a Unix domain socket
+ *
+ * The path of the socket is stored in soap->user.
+ */
+static SOAP_SOCKET unixConnect (struct soap *soap, const char *endpoint, const char *host, int port){
+
+    struct sockaddr_un address;
+    SOAP_SOCKET s;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, (const char*) soap->user, sizeof(address.sun_path) - 1);
+
+	s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s < 0 || connect(s, (struct sockaddr*) &address, sizeof(address)) < 0){
+		soap->errnum = errno;
+		soap->error = SOAP_TCP_ERROR;
+		if (s >= 0)
+			close(s);
+		return SOAP_INVALID_SOCKET;
+	}
+
+	return s;
+}
+
+SOAP_SOCKET bindUnixSocket (const char *path, int backlog){
+
+    struct sockaddr_un address;
+    SOAP_SOCKET s;
+
+	if (strlen(path) >= sizeof(address.sun_path))
+		return SOAP_INVALID_SOCKET;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+
+	// Remove the socket of a previous run
+	unlink(path);
+
+	s = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (s < 0)
+		return SOAP_INVALID_SOCKET;
+
+	if (bind(s, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(s, backlog) < 0){
+		close(s);
+		return SOAP_INVALID_SOCKET;
+	}
+
+	return s;
+}
+
+int useUnixEndpoint (struct soap *soap, char **endpoint){
+
+	if (strncmp(*endpoint, UNIX_ENDPOINT_PREFIX, strlen(UNIX_ENDPOINT_PREFIX)) != 0)
+		return FALSE;
+
+	soap->user = *endpoint + strlen(UNIX_ENDPOINT_PREFIX);
+	soap->fopen = unixConnect;
+	*endpoint = UNIX_HTTP_ENDPOINT;
+
+	return TRUE;
+}
+
+unsigned int backoffDelay (unsigned int attempt, int retryAfter){
+
+	unsigned int limit = BACKOFF_MAX_MS;
+	unsigned int delay, hint;
+
+	// Exponential limit, capped
+	if (attempt < 16 && (BACKOFF_BASE_MS << attempt) < BACKOFF_MAX_MS)
+		limit = BACKOFF_BASE_MS << attempt;
+
+	// Full jitter, so the clients do not retry at the same time
+	delay = rand() % (limit + 1);
+
+	// The hint of the server is the earliest retry, with a little jitter
+	if (retryAfter > 0){
+		hint = retryAfter + rand() % (retryAfter / 4 + 1);
+		if (hint > delay)
+			delay = hint;
+	}
+
+	return delay;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "soapH.h"
+
+/** Prefix of the endpoints that use a Unix domain socket, e.g. unix:/tmp/conecta4.sock */
+#define UNIX_ENDPOINT_PREFIX "unix:"
+
+/** HTTP endpoint used in the SOAP calls sent through a Unix domain socket */
+#define UNIX_HTTP_ENDPOINT "http://localhost"
+
+/** First delay between register retries (in milliseconds) */
+#define BACKOFF_BASE_MS 100
+
+/** Maximum delay between register retries (in milliseconds) */
+#define BACKOFF_MAX_MS 10000
+
+/**
+ * Creates a Unix domain socket listening on a path
+ *
+ * An existing file at the path is removed first.
+ *
+ * @param path Path of the socket
+ * @param backlog Maximum length of the queue of pending connections
+ * @return Listening socket, or SOAP_INVALID_SOCKET if it cannot be created
+ */
+SOAP_SOCKET bindUnixSocket (const char *path, int backlog);
+
+/**
+ * Configures a client context to connect through a Unix domain socket
+ *
+ * If the endpoint starts with UNIX_ENDPOINT_PREFIX, the calls of the context are sent
+ * through the socket at the rest of the endpoint, and the endpoint is replaced with
+ * UNIX_HTTP_ENDPOINT. Other endpoints are not modified.
+ *
+ * @param soap Soap context of the client
+ * @param endpoint Endpoint given by the user. Updated with the endpoint for the SOAP calls
+ * @return TRUE if the endpoint is a Unix domain socket, or FALSE in another case
+ */
+int useUnixEndpoint (struct soap *soap, char **endpoint);
+
+/**
+ * Computes the delay before retrying a register request.
+ *
+ * Uses exponential backoff with full jitter, and never retries before the hint sent by the
+ * server (with a little jitter), so the client is not back before the server expects it.
+ * Players in the admission queue pass attempt 0, so they follow the hint of their position.
+ *
+ * @param attempt Number of failed attempts so far, without counting those that got a queue position
+ * @param retryAfter Retry hint sent by the server (in milliseconds)
+ * @return Delay in milliseconds
+ */
+unsigned int backoffDelay (unsigned int attempt, int retryAfter);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "ttable.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Flag that marks an entry as used */
+#define TT_VALID_BIT (1ULL << 30)
+
+/** Offset added to the scores so they are stored as unsigned numbers */
+#define TT_SCORE_OFFSET 32768
+
+
+/**
+ * Packs the data of an entry in one word
+ */
+static uint64_t packData (int score, int depth, tBound bound, int move){
+	return ((uint64_t)(score + TT_SCORE_OFFSET) & 0xFFFF) |
+		   (((uint64_t)depth & 0xFF) << 16) |
+		   (((uint64_t)bound & 0x3) << 24) |
+		   (((uint64_t)move & 0xF) << 26) |
+		   TT_VALID_BIT;
+}
+
+static int dataDepth (uint64_t data){
+	return (int)((data >> 16) & 0xFF);
+}
+
+int ttInit (tTTable *table, size_t bytes){
+
+    size_t buckets = 1;
+
+	// Largest power of two that fits in the budget
+	while ((buckets * 2 * sizeof(tTTBucket)) <= bytes)
+		buckets *= 2;
+
+	table->buckets = (tTTBucket*) aligned_alloc(CACHE_LINE_SIZE, buckets * sizeof(tTTBucket));
+	if (table->buckets == NULL)
+		return FALSE;
+
+	table->mask = buckets - 1;
+	ttClear(table);
+
+	return TRUE;
+}
+
+void ttFree (tTTable *table){
+	free(table->buckets);
+	table->buckets = NULL;
+	table->mask = 0;
+}
+
+void ttClear (tTTable *table){
+	memset(table->buckets, 0, (table->mask + 1) * sizeof(tTTBucket));
+}
+
+int ttProbe (tTTable *table, tHash hash, int *score, int *depth, tBound *bound, int *move, tTTStats *stats){
+
+    tTTBucket *bucket = &table->buckets[hash & table->mask];
+    int occupied = 0;
+
+	stats->probes++;
+
+	for (int i = 0; i < TT_BUCKET_ENTRIES; i++){
+
+		uint64_t data = __atomic_load_n(&bucket->entry[i].data, __ATOMIC_RELAXED);
+		uint64_t check = __atomic_load_n(&bucket->entry[i].check, __ATOMIC_RELAXED);
+
+		if (!(data & TT_VALID_BIT))
+			continue;
+
+		// Torn entries and other positions do not pass this check
+		if ((check ^ data) == hash){
+			*score = (int)(data & 0xFFFF) - TT_SCORE_OFFSET;
+			*depth = dataDepth(data);
+			*bound = (tBound)((data >> 24) & 0x3);
+			*move = (int)((data >> 26) & 0xF);
+			stats->hits++;
+			return TRUE;
+		}
+
+		occupied++;
+	}
+
+	if (occupied == TT_BUCKET_ENTRIES)
+		stats->collisions++;
+
+	return FALSE;
+}
+
+void ttStore (tTTable *table, tHash hash, int score, int depth, tBound bound, int move, tTTStats *stats){
+
+    tTTBucket *bucket = &table->buckets[hash & table->mask];
+    uint64_t newData = packData(score, depth, bound, move);
+    int victim = -1;
+    int victimDepth = 256;
+
+	for (int i = 0; (i < TT_BUCKET_ENTRIES) && (victimDepth >= 0); i++){
+
+		uint64_t data = __atomic_load_n(&bucket->entry[i].data, __ATOMIC_RELAXED);
+		uint64_t check = __atomic_load_n(&bucket->entry[i].check, __ATOMIC_RELAXED);
+
+		// Same position or empty entry: use it
+		if (!(data & TT_VALID_BIT) || ((check ^ data) == hash)){
+			victim = i;
+			victimDepth = -1;
+		}
+
+		// In another case, replace the shallowest entry
+		else if (dataDepth(data) < victimDepth){
+			victim = i;
+			victimDepth = dataDepth(data);
+		}
+	}
+
+	if (victimDepth >= 0)
+		stats->replaced++;
+
+	__atomic_store_n(&bucket->entry[victim].check, hash ^ newData, __ATOMIC_RELAXED);
+	__atomic_store_n(&bucket->entry[victim].data, newData, __ATOMIC_RELAXED);
+	stats->stores++;
+}
+
+void ttAddStats (tTTStats *total, tTTStats *stats){
+	total->probes += stats->probes;
+	total->hits += stats->hits;
+	total->collisions += stats->collisions;
+	total->stores += stats->stores;
+	total->replaced += stats->replaced;
+}
\ No newline at end of file
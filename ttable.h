@@ -0,0 +1,123 @@
+#ifndef TTABLE_H
+#define TTABLE_H
+
+#include "zobrist.h"
+#include <stddef.h>
+
+/** Default memory budget of the transposition table (in megabytes) */
+#define TT_DEFAULT_MB 16
+
+/** Number of entries in each bucket. A bucket fills one cache line */
+#define TT_BUCKET_ENTRIES 4
+
+/** Size of a cache line (in bytes) */
+#define CACHE_LINE_SIZE 64
+
+/** Value stored as move when there is no best move */
+#define TT_NO_MOVE BOARD_WIDTH
+
+/** Type of bound stored for a score */
+typedef enum { ttExact, ttLower, ttUpper } tBound;
+
+/**
+ * Entry of the transposition table.
+ *
+ * Both words are written without locks, and the key is stored as hash ^ data, so
+ * an entry torn by two concurrent stores does not match any position.
+ */
+typedef struct ttEntry{
+
+	uint64_t check;						/** Hash of the position xor data */
+	uint64_t data;						/** Score, depth, bound and best move */
+}tTTEntry;
+
+/**
+ * Group of entries that share a cache line
+ */
+typedef struct ttBucket{
+
+	tTTEntry entry[TT_BUCKET_ENTRIES];	/** Entries of the bucket */
+}__attribute__((aligned(CACHE_LINE_SIZE))) tTTBucket;
+
+/**
+ * Transposition table shared by all the search threads
+ */
+typedef struct ttable{
+
+	tTTBucket *buckets;					/** Array of buckets */
+	uint64_t mask;						/** Number of buckets - 1 */
+}tTTable;
+
+/**
+ * Counters of the transposition table, kept by each thread
+ */
+typedef struct ttStats{
+
+	unsigned long probes;				/** Number of lookups */
+	unsigned long hits;					/** Lookups that found the position */
+	unsigned long collisions;			/** Lookups that found a bucket full of other positions */
+	unsigned long stores;				/** Number of stored entries */
+	unsigned long replaced;				/** Stores that evicted another position */
+}tTTStats;
+
+/**
+ * Allocates a transposition table
+ *
+ * The number of buckets is the largest power of two that fits in the budget.
+ *
+ * @param table Table to be initialized
+ * @param bytes Memory budget
+ * @return TRUE if the table has been allocated, or FALSE in another case
+ */
+int ttInit (tTTable *table, size_t bytes);
+
+/**
+ * Frees the memory of a transposition table
+ *
+ * @param table Table to be freed
+ */
+void ttFree (tTTable *table);
+
+/**
+ * Removes every entry of a transposition table
+ *
+ * @param table Table to be cleared
+ */
+void ttClear (tTTable *table);
+
+/**
+ * Looks for a position in the transposition table
+ *
+ * @param table Transposition table
+ * @param hash Hash of the position
+ * @param score Stored score
+ * @param depth Depth of the search that produced the score
+ * @param bound Type of bound of the score
+ * @param move Best move, or TT_NO_MOVE
+ * @param stats Counters of the calling thread
+ * @return TRUE if the position has been found, or FALSE in another case
+ */
+int ttProbe (tTTable *table, tHash hash, int *score, int *depth, tBound *bound, int *move, tTTStats *stats);
+
+/**
+ * Stores a position in the transposition table
+ *
+ * @param table Transposition table
+ * @param hash Hash of the position
+ * @param score Score of the position
+ * @param depth Depth of the search that produced the score
+ * @param bound Type of bound of the score
+ * @param move Best move, or TT_NO_MOVE
+ * @param stats Counters of the calling thread
+ */
+void ttStore (tTTable *table, tHash hash, int score, int depth, tBound bound, int move, tTTStats *stats);
+
+/**
+ * Adds the counters of a thread to a total
+ *
+ * @param total Accumulated counters
+ * @param stats Counters to be added
+ */
+void ttAddStats (tTTStats *total, tTTStats *stats);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "zobrist.h"
+
+/** Key for each player and cell */
+tHash zobristCells[2][BOARD_WIDTH * BOARD_HEIGHT];
+
+/** Key for the player to move */
+tHash zobristSide;
+
+
+/**
+ * Generates the next pseudo-random key (splitmix64)
+ *
+ * @param state State of the generator
+ * @return New key
+ */
+static tHash nextKey (uint64_t *state){
+
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+void initZobrist (){
+
+    uint64_t state = ZOBRIST_SEED;
+
+	for (int i = 0; i < (BOARD_WIDTH * BOARD_HEIGHT); i++){
+		zobristCells[player1][i] = nextKey(&state);
+		zobristCells[player2][i] = nextKey(&state);
+	}
+
+	zobristSide = nextKey(&state);
+}
+
+tHash hashBoard (xsd__string board, conecta4ns__tPlayer player){
+
+    tHash hash = 0;
+
+	for (int i = 0; i < (BOARD_WIDTH * BOARD_HEIGHT); i++){
+		if (board[i] == PLAYER_1_CHIP)
+			hash ^= zobristCells[player1][i];
+		else if (board[i] == PLAYER_2_CHIP)
+			hash ^= zobristCells[player2][i];
+	}
+
+	if (player == player2)
+		hash ^= zobristSide;
+
+	return hash;
+}
+
+unsigned int insertChipHashed (xsd__string board, conecta4ns__tPlayer player, unsigned int column, tHash *hash){
+
+    unsigned int cell = getDropCell(board, column);
+
+	insertChip(board, player, column);
+	*hash ^= zobristCells[player][cell] ^ zobristSide;
+
+	return cell;
+}
+
+void removeChipHashed (xsd__string board, conecta4ns__tPlayer player, unsigned int cell, tHash *hash){
+
+	board[cell] = EMPTY_CELL;
+	*hash ^= zobristCells[player][cell] ^ zobristSide;
+}
\ No newline at end of file
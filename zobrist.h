@@ -0,0 +1,50 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include "game.h"
+#include <stdint.h>
+
+/** Seed for the Zobrist keys, fixed so hashes are the same in every run */
+#define ZOBRIST_SEED 0x9E3779B97F4A7C15ULL
+
+/** Hash of a board */
+typedef uint64_t tHash;
+
+/**
+ * Init the Zobrist keys. Must be called once before any other function of this module
+ */
+void initZobrist ();
+
+/**
+ * Computes the hash of a board from scratch
+ *
+ * @param board Board of the game
+ * @param player Player that must move
+ * @return Hash of the board and the player to move
+ */
+tHash hashBoard (xsd__string board, conecta4ns__tPlayer player);
+
+/**
+ * Inserts a chip in the board and updates the hash of the board
+ *
+ * The hash also switches the player to move.
+ *
+ * @param board Board of the game
+ * @param player Player that must move
+ * @param column Column to insert the chip
+ * @param hash Hash of the board, updated with the move
+ * @return Cell where the chip has been inserted
+ */
+unsigned int insertChipHashed (xsd__string board, conecta4ns__tPlayer player, unsigned int column, tHash *hash);
+
+/**
+ * Removes a chip inserted with insertChipHashed and restores the hash of the board
+ *
+ * @param board Board of the game
+ * @param player Player that performed the move
+ * @param cell Cell returned by insertChipHashed
+ * @param hash Hash of the board, restored to the value before the move
+ */
+void removeChipHashed (xsd__string board, conecta4ns__tPlayer player, unsigned int cell, tHash *hash);
+
+#endif
\ No newline at end of file